@@ -35,33 +35,47 @@
   POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "mappedarray.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "reductions.h"
 #include "types.h"
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <list>
 #include <deque>
 #include <forward_list>
+#include <map>
 
 void print(const TypeErasure::Variant &var)
 {
     std::cout << "Item: ";
-    if (var.type() == typeid(int).hash_code())
+    if (var.type() == TypeErasure::metaTypeId<int>())
         std::cout << var.as<int>();
-    else if (var.type() == typeid(std::string).hash_code())
-        std::cout << var.as<std::string>();
-    else if (var.type() == typeid(double).hash_code())
+    else if (var.type() == TypeErasure::metaTypeId<std::string>())
+        std::cout << var.asRef<std::string>();
+    else if (var.type() == TypeErasure::metaTypeId<double>())
         std::cout << var.as<double>();
       // Delibrately omitted to show that the limitation in the testcase is of
       // printing elements only.  The type-erased container abstraction can
       // iterate over the elements, can determine the size of the container etc.
-//     else if (var.type() == typeid(bool).hash_code())
+//     else if (var.type() == TypeErasure::metaTypeId<bool>())
 //         std::cout << std::boolalpha << var.as<bool>();
     else
         std::cout << "<Unknown>";
     std::cout << std::endl;
 }
 
+struct Printer
+{
+    void operator()(int i) const { std::cout << "Item: " << i << std::endl; }
+    void operator()(double d) const { std::cout << "Item: " << d << std::endl; }
+    void operator()(const std::string &s) const { std::cout << "Item: " << s << std::endl; }
+};
+
 int main(int argc, char **argv)
 {
     {
@@ -83,6 +97,78 @@ int main(int argc, char **argv)
         {
         print(*it);
         }
+
+    // Demonstrate constant-time indexed access.
+    if (iter.canRandomAccess())
+        {
+        std::cout << "Last: ";
+        print(iter[iter.size() - 1]);
+        }
+
+    // Demonstrate a reduction over the typed elements.
+    double sum;
+    if (TypeErasure::sum(iter, &sum))
+        std::cout << "Sum: " << sum << std::endl;
+
+    // Demonstrate a lazy pipeline, which creates no intermediate containers.
+    std::cout << "Filtered:" << std::endl;
+    auto large = [](const TypeErasure::Variant &v) { return v.as<int>() > 3; };
+    for (auto v : TypeErasure::generate(iter).filter(large).take(2))
+        {
+        print(v);
+        }
+
+    // Demonstrate serialization, and reading the elements back in place.
+    TypeErasure::BufferWriter writer;
+    TypeErasure::ArrayView<int> view;
+    if (iter.serialize(writer)
+            && TypeErasure::readSerialized(writer.buffer().data(), writer.buffer().size(), &view))
+        {
+        std::cout << "Deserialized:" << std::endl;
+        for (auto v : TypeErasure::Variant(view).as<TypeErasure::SequentialIterable>())
+            {
+            print(v);
+            }
+        }
+    }
+
+    {
+    std::vector<int> vec(100000);
+    for (int i = 0; i < static_cast<int>(vec.size()); ++i)
+        vec[i] = i % 10;
+
+    TypeErasure::Variant var(vec);
+
+    TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+
+    // Demonstrate a reduction whose chunks are folded concurrently, here by
+    // four threads.
+    const long long parallelSum = TypeErasure::parallelReduce(iter, 0LL,
+        [](long long sum, const TypeErasure::Variant &v) { return sum + v.as<int>(); },
+        [](long long a, long long b) { return a + b; }, 4);
+    std::cout << "Parallel sum: " << parallelSum << std::endl;
+    }
+
+    {
+    std::vector<int> vec;
+    vec.push_back(3);
+    vec.push_back(5);
+    vec.push_back(8);
+
+    TypeErasure::BufferWriter writer;
+    TypeErasure::Variant(vec).as<TypeErasure::SequentialIterable>().serialize(writer);
+    const char *path = "basictest-mapped.bin";
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(writer.buffer().data()), writer.buffer().size());
+
+    // Demonstrate iterating the elements of a file in place, skipping the
+    // serialization header.
+    TypeErasure::MappedArray<int> mapped(path, sizeof(TypeErasure::SerializationHeader));
+    TypeErasure::Variant var(mapped);
+
+    double sum;
+    if (mapped.isOpen() && TypeErasure::sum(var.as<TypeErasure::SequentialIterable>(), &sum))
+        std::cout << "Mapped sum: " << sum << std::endl;
+    std::remove(path);
     }
 
     {
@@ -126,6 +212,25 @@ int main(int argc, char **argv)
         print(v);
         }
 
+    // Demonstrate fetching several elements in one operation.
+    std::cout << "Middle:" << std::endl;
+    const void *middle[2];
+    const int fetched = iter.getRange(1, 2, middle);
+    for (int i = 0; i < fetched; ++i)
+        {
+        print(TypeErasure::VariantData(iter.elementType(), middle[i]));
+        }
+
+    // Demonstrate indexed access with a cached cursor, which advances from
+    // the previously accessed element.
+    std::cout << "Indexed:" << std::endl;
+    iter.setCursorCacheEnabled(true);
+    for (int i = 0; i < iter.size(); ++i)
+        {
+        print(iter[i]);
+        }
+    iter.setCursorCacheEnabled(false);
+
     std::cout << "Reverse:" << std::endl;
     const auto beginIt = std::begin(iter);
     auto it = std::end(iter);
@@ -135,6 +240,20 @@ int main(int argc, char **argv)
         --it;
         print(*it);
         } while (it != beginIt);
+
+    // Demonstrate the same with a reverse iterator.
+    std::cout << "Reverse iterator:" << std::endl;
+    for (auto rit = iter.rbegin(); rit != iter.rend(); ++rit)
+        {
+        print(*rit);
+        }
+
+    // Demonstrate visiting every second element.
+    std::cout << "Stride:" << std::endl;
+    for (auto v : iter.stride(2))
+        {
+        print(v);
+        }
     }
 
     {
@@ -153,6 +272,21 @@ int main(int argc, char **argv)
         {
         print(v);
         }
+
+    // Demonstrate allocating the iterators which can not be stored inline
+    // (with libstdc++, those of std::deque) from an arena instead of the
+    // global heap.  The arena is reset once the iterators are destroyed.
+    TypeErasure::IteratorArena arena;
+    iter.setIteratorArena(&arena);
+    int trueCount = 0;
+    for (auto v : iter)
+        {
+        if (v.as<bool>())
+            ++trueCount;
+        }
+    iter.setIteratorArena(0);
+    arena.reset();
+    std::cout << "True elements: " << trueCount << std::endl;
     }
 
     {
@@ -171,6 +305,118 @@ int main(int argc, char **argv)
         {
         print(v);
         }
+
+    // Demonstrate typed iteration, with the element type checked only once.
+    std::cout << "Visit:" << std::endl;
+    iter.visit<int, std::string, double>(Printer());
+
+    // Demonstrate constant-time indexing through an index of the element
+    // addresses, which is built by walking the container once.
+    std::cout << "Index:" << std::endl;
+    iter.buildIndex();
+    for (int i = iter.size() - 1; i >= 0; --i)
+        {
+        print(iter.at(i));
+        }
+    iter.clearIndex();
+    }
+
+    {
+    std::map<std::string, int> ma;
+    ma["one"] = 1;
+    ma["two"] = 2;
+    ma["three"] = 3;
+
+    TypeErasure::Variant var(ma);
+
+    TypeErasure::AssociativeIterable iter = var.as<TypeErasure::AssociativeIterable>();
+
+    std::cout << "Map size: " << iter.size() << std::endl;
+
+    // Demonstrate iteration over keys and values.
+    for (auto it = iter.begin(); it != iter.end(); ++it)
+        {
+        print(it.key());
+        print(it.value());
+        }
+
+    // Demonstrate lookup with the find of the container.
+    const std::string key = "two";
+    auto found = iter.find(key);
+    if (found != iter.end())
+        {
+        std::cout << "Found: ";
+        print(*found);
+        }
+    }
+
+    {
+    int arr[] = { 2, 3, 5, 7, 11 };
+
+    TypeErasure::Variant var(arr);
+
+    TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+
+    std::cout << "Array size: " << iter.size();
+    std::cout << " (Can " << (iter.isContiguous() ? "" : "not ") << "access contiguously)" << std::endl;
+
+    // Demonstrate direct access to contiguous elements without iterators.
+    const TypeErasure::MetaTypeId elementType = (*iter.begin()).type();
+    const char *element = static_cast<const char*>(iter.data());
+    for (int i = 0; i < iter.size(); ++i, element += iter.elementSize())
+        {
+        print(TypeErasure::VariantData(elementType, element));
+        }
+    }
+
+    {
+    const int one = 1;
+    std::vector<int> ints;
+    ints.push_back(2);
+    ints.push_back(3);
+    std::list<double> doubles;
+    doubles.push_back(4.5);
+    const std::vector<int> empty;
+    std::vector<TypeErasure::Variant> inner;
+    inner.push_back(TypeErasure::Variant(doubles));
+    inner.push_back(TypeErasure::Variant(empty));
+
+    std::vector<TypeErasure::Variant> tree;
+    tree.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<int>(), &one));
+    tree.push_back(TypeErasure::Variant(ints));
+    tree.push_back(TypeErasure::Variant(inner));
+
+    TypeErasure::Variant var(tree);
+
+    TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+
+    // Demonstrate depth-first iteration over the leaves of nested containers.
+    std::cout << "Flattened:" << std::endl;
+    for (TypeErasure::FlatteningIterator it(iter); !it.atEnd(); ++it)
+        {
+        print(*it);
+        }
+    }
+
+    {
+    const int one = 1;
+    const int two = 2;
+    const double half = 0.5;
+    const std::string text = "mixed";
+    std::vector<TypeErasure::Variant> mixed;
+    mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<int>(), &one));
+    mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<std::string>(), &text));
+    mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<double>(), &half));
+    mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<int>(), &two));
+
+    TypeErasure::Variant var(mixed);
+
+    TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+
+    // Demonstrate typed iteration over elements of mixed types, grouped by
+    // type so that the type is checked once per group.
+    std::cout << "Grouped:" << std::endl;
+    iter.visitGrouped<int, double, std::string>(Printer());
     }
 
     return 0;
@@ -0,0 +1,353 @@
+/*
+  This file is part of an example implementation of type-erased container
+  iteration
+
+  Copyright (C) 2026 Klarälvdalens Datakonsult AB, a KDAB Group company, 
+  info@kdab.com
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, 
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, 
+  this list of conditions and the following disclaimer in the documentation 
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors 
+  may be used to endorse or promote products derived from this software without 
+  specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+  LIABLE FOR   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+  CONSEQUENTIAL DAMAGES   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  Microbenchmarks of the type-erased container iteration, in the style of
+  Google Benchmark.  Each benchmark is run repeatedly until it has taken at
+  least the minimum time, and the mean time per iteration is reported.  The
+  "DirectLoop" benchmarks iterate the strongly-typed container and are the
+  baseline for the overhead of the type-erasure.
+
+  Build with optimizations, for example:
+
+    g++ -std=c++11 -O2 -pthread benchmark.cpp -o benchmark
+
+  Defining TYPEERASURE_INSTRUMENTATION also prints the instrumentation
+  counters accumulated by the benchmarks run:
+
+    g++ -std=c++11 -O2 -pthread -DTYPEERASURE_INSTRUMENTATION benchmark.cpp -o benchmark
+
+  An optional argument restricts the benchmarks run to those whose name
+  contains it.
+*/
+
+#include "parallel.h"
+#include "reductions.h"
+#include "types.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <forward_list>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char *filter = 0;
+
+template<typename T>
+void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+/**
+  Run ``f`` (which performs one iteration of the benchmark) until at least
+  the minimum time has passed, and print the time per iteration and, if
+  ``itemsPerIteration`` is not zero, per item.
+ */
+template<typename F>
+void runBenchmark(const std::string &name, F f, long itemsPerIteration = 0)
+{
+    if (filter && name.find(filter) == std::string::npos)
+        return;
+
+    typedef std::chrono::steady_clock Clock;
+    const std::chrono::nanoseconds minimumTime = std::chrono::milliseconds(100);
+
+    long iterations = 1;
+    std::chrono::nanoseconds elapsed;
+    for (;;) {
+        const Clock::time_point start = Clock::now();
+        for (long i = 0; i < iterations; ++i)
+            f();
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        if (elapsed >= minimumTime || iterations >= (1L << 30))
+            break;
+        iterations *= elapsed.count() > 0 ? std::min<long>(10, std::max<long>(2, minimumTime.count() * 2 / elapsed.count())) : 10;
+    }
+
+    const double perIteration = double(elapsed.count()) / iterations;
+    std::printf("%-48s %12.1f ns %12ld", name.c_str(), perIteration, iterations);
+    if (itemsPerIteration)
+        std::printf(" %10.2f ns/item", perIteration / itemsPerIteration);
+    std::printf("\n");
+}
+
+template<typename Container>
+Container makeContainer(int size)
+{
+    Container c(size);
+    int i = 0;
+    for (typename Container::iterator it = c.begin(); it != c.end(); ++it)
+        *it = i++;
+    return c;
+}
+
+template<typename Container>
+void benchmarkContainer(const char *containerName, int size)
+{
+    const Container container = makeContainer<Container>(size);
+    const TypeErasure::Variant var(container);
+    const TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+    const std::string suffix = std::string("/") + containerName + "/" + std::to_string(size);
+
+    runBenchmark("BM_BeginEnd" + suffix, [&] {
+        TypeErasure::SequentialIterable::const_iterator it = iter.begin();
+        TypeErasure::SequentialIterable::const_iterator end = iter.end();
+        doNotOptimize(it);
+        doNotOptimize(end);
+    });
+
+    TypeErasure::SequentialIterable arenaIter = iter;
+    TypeErasure::IteratorArena &arena = TypeErasure::IteratorArena::forCurrentThread();
+    arenaIter.setIteratorArena(&arena);
+    runBenchmark("BM_BeginEndArena" + suffix, [&] {
+        {
+            TypeErasure::SequentialIterable::const_iterator it = arenaIter.begin();
+            TypeErasure::SequentialIterable::const_iterator end = arenaIter.end();
+            doNotOptimize(it);
+            doNotOptimize(end);
+        }
+        arena.reset();
+    });
+
+    runBenchmark("BM_Iterate" + suffix, [&] {
+        int sum = 0;
+        for (TypeErasure::SequentialIterable::const_iterator it = iter.begin(), end = iter.end(); it != end; ++it)
+            sum += (*it).as<int>();
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_DirectLoop" + suffix, [&] {
+        int sum = 0;
+        for (typename Container::const_iterator it = container.begin(), end = container.end(); it != end; ++it)
+            sum += *it;
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_ForEachRaw" + suffix, [&] {
+        int sum = 0;
+        iter.forEachRaw([&](const void *const *elements, int count) {
+            for (int i = 0; i < count; ++i)
+                sum += *static_cast<const int*>(elements[i]);
+        });
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_Stride16" + suffix, [&] {
+        int sum = 0;
+        for (TypeErasure::Variant v : iter.stride(16))
+            sum += v.as<int>();
+        doNotOptimize(sum);
+    }, (size + 15) / 16);
+
+    runBenchmark("BM_Sum" + suffix, [&] {
+        double sum = 0;
+        TypeErasure::sum(iter, &sum);
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_ParallelReduce" + suffix, [&] {
+        const long long sum = TypeErasure::parallelReduce(iter, 0LL,
+            [](long long sum, const TypeErasure::Variant &v) { return sum + v.as<int>(); },
+            [](long long a, long long b) { return a + b; });
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_Size" + suffix, [&] {
+        doNotOptimize(iter.size());
+    });
+
+    if (iter.canRandomAccess()) {
+        runBenchmark("BM_At" + suffix, [&] {
+            int sum = 0;
+            for (int i = 0; i < size; ++i)
+                sum += iter.at(i).as<int>();
+            doNotOptimize(sum);
+        }, size);
+    } else {
+        TypeErasure::SequentialIterable cursorIter = iter;
+        cursorIter.setCursorCacheEnabled(true);
+        runBenchmark("BM_CursorAt" + suffix, [&] {
+            int sum = 0;
+            for (int i = 0; i < size; ++i)
+                sum += cursorIter.at(i).as<int>();
+            doNotOptimize(sum);
+        }, size);
+
+        TypeErasure::SequentialIterable indexedIter = iter;
+        indexedIter.buildIndex();
+        runBenchmark("BM_IndexAt" + suffix, [&] {
+            int sum = 0;
+            for (int i = size - 1; i >= 0; --i)
+                sum += indexedIter.at(i).as<int>();
+            doNotOptimize(sum);
+        }, size);
+    }
+
+    runBenchmark("BM_AsSequentialIterable" + suffix, [&] {
+        TypeErasure::SequentialIterable converted = var.as<TypeErasure::SequentialIterable>();
+        doNotOptimize(converted);
+    });
+}
+
+template<typename Container>
+void benchmarkRegistry(const char *containerName)
+{
+    const Container container = makeContainer<Container>(16);
+    const std::string suffix = std::string("/") + containerName;
+
+    runBenchmark("BM_VariantConstruction" + suffix, [&] {
+        TypeErasure::Variant var(container);
+        doNotOptimize(var);
+    });
+
+    runBenchmark("BM_RegistryInsert" + suffix, [&] {
+        doNotOptimize(TypeErasure::converterRegistry.insert(TypeErasure::metaTypeId<Container>(),
+                                                            TypeErasure::SequentialIterableImplementation::operationsFor<Container>()));
+    });
+
+    runBenchmark("BM_RegistryFind" + suffix, [&] {
+        doNotOptimize(TypeErasure::converterRegistry.find(TypeErasure::metaTypeId<Container>()));
+    });
+}
+
+/**
+  Benchmarks of a ``std::vector<Variant>`` whose elements alternate
+  irregularly between ``int`` and ``double`` values.
+ */
+void benchmarkMixed(int size)
+{
+    std::vector<int> ints(size);
+    std::vector<double> doubles(size);
+    std::vector<TypeErasure::Variant> mixed;
+    unsigned state = 1;
+    for (int i = 0; i < size; ++i) {
+        ints[i] = i;
+        doubles[i] = i;
+        state = state * 1103515245 + 12345;
+        if (state & 0x10000)
+            mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<int>(), &ints[i]));
+        else
+            mixed.push_back(TypeErasure::VariantData(TypeErasure::metaTypeId<double>(), &doubles[i]));
+    }
+    const TypeErasure::Variant var(mixed);
+    const TypeErasure::SequentialIterable iter = var.as<TypeErasure::SequentialIterable>();
+    const std::string suffix = "/mixed/" + std::to_string(size);
+
+    runBenchmark("BM_MixedIterate" + suffix, [&] {
+        double sum = 0;
+        for (TypeErasure::SequentialIterable::const_iterator it = iter.begin(), end = iter.end(); it != end; ++it) {
+            const TypeErasure::Variant v = *it;
+            if (const int *i = v.get_if<int>())
+                sum += *i;
+            else if (const double *d = v.get_if<double>())
+                sum += *d;
+        }
+        doNotOptimize(sum);
+    }, size);
+
+    runBenchmark("BM_VisitGrouped" + suffix, [&] {
+        struct Accumulate
+        {
+            double sum;
+            void operator()(int i) { sum += i; }
+            void operator()(double d) { sum += d; }
+        } accumulate = { 0 };
+        iter.visitGrouped<int, double>(accumulate);
+        doNotOptimize(accumulate.sum);
+    }, size);
+}
+
+#ifdef TYPEERASURE_INSTRUMENTATION
+void printInstrumentation()
+{
+    const TypeErasure::InstrumentationSnapshot snapshot = TypeErasure::instrumentationSnapshot();
+    std::printf("\nInstrumentation counters\n");
+    std::printf("%-48s %15llu\n", "registryInserts", snapshot.registryInserts);
+    std::printf("%-48s %15llu\n", "registryLookups", snapshot.registryLookups);
+    std::printf("%-48s %15llu\n", "heapIterators", snapshot.heapIterators);
+    std::printf("%-48s %15llu\n", "iteratorCopies", snapshot.iteratorCopies);
+    std::printf("%-48s %15llu\n", "atCalls", snapshot.atCalls);
+    std::printf("%-48s %15llu\n", "atAdvanceDistance", snapshot.atAdvanceDistance);
+    for (const TypeErasure::InstrumentationSnapshot::ContainerType &type : snapshot.containerTypes)
+        std::printf("%-48s %15llu iterations %15llu steps\n", type.name, type.iterations, type.steps);
+}
+#endif
+
+template<typename Container>
+void benchmarkAll(const char *containerName)
+{
+    const int sizes[] = { 16, 1024, 65536 };
+    for (int size : sizes)
+        benchmarkContainer<Container>(containerName, size);
+    benchmarkRegistry<Container>(containerName);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        filter = argv[1];
+
+    std::printf("%-48s %15s %12s\n", "Benchmark", "Time", "Iterations");
+
+    benchmarkAll<std::vector<int> >("vector");
+    benchmarkAll<std::list<int> >("list");
+    benchmarkAll<std::deque<int> >("deque");
+    benchmarkAll<std::forward_list<int> >("forward_list");
+
+    const int mixedSizes[] = { 1024, 65536 };
+    for (int size : mixedSizes)
+        benchmarkMixed(size);
+
+#ifdef TYPEERASURE_INSTRUMENTATION
+    printInstrumentation();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+  This file is part of an example implementation of type-erased container
+  iteration
+
+  Copyright (C) 2026 Klarälvdalens Datakonsult AB, a KDAB Group company, 
+  info@kdab.com
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, 
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, 
+  this list of conditions and the following disclaimer in the documentation 
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors 
+  may be used to endorse or promote products derived from this software without 
+  specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+  LIABLE FOR   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+  CONSEQUENTIAL DAMAGES   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TYPEERASURE_MAPPEDARRAY_H
+#define TYPEERASURE_MAPPEDARRAY_H
+
+#include "types.h"
+
+#include <climits>
+#include <cstddef>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TypeErasure
+{
+
+/**
+  @brief Read-only container of the elements of type ``T`` stored in a file.
+
+  The file is mapped into memory with POSIX ``mmap``, so the elements are
+  paged in on access instead of being read into memory up front.  The
+  const_iterator is a pointer into the mapping, so a MappedArray is a
+  contiguous, random-access container, and wrapping it in a Variant allows
+  iterating it as a SequentialIterable without copying.
+
+  The elements start at ``offset`` bytes into the file, which allows
+  skipping a header such as the SerializationHeader, and extend to the last
+  complete element.  The file must not be truncated while it is mapped.
+
+  As the size of a SequentialIterable is an ``int``, files of more than
+  ``INT_MAX`` elements are not mapped, and the MappedArray is then not open.
+ */
+template<typename T>
+class MappedArray
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "MappedArray requires elements which can be used in place");
+
+public:
+    typedef T value_type;
+    typedef const T *const_iterator;
+
+    explicit MappedArray(const char *path, std::size_t offset = 0);
+    ~MappedArray();
+
+    MappedArray(MappedArray &&other);
+    MappedArray &operator=(MappedArray &&other);
+
+    MappedArray(const MappedArray &) = delete;
+    MappedArray &operator=(const MappedArray &) = delete;
+
+    /**
+      Whether the file could be opened and mapped.  A MappedArray which is
+      not open is empty.
+     */
+    bool isOpen() const { return m_open; }
+
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+    const T *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    void unmap();
+
+    void *m_mapping;
+    std::size_t m_mappingSize;
+    const T *m_data;
+    std::size_t m_size;
+    bool m_open;
+};
+
+template<typename T>
+MappedArray<T>::MappedArray(const char *path, std::size_t offset)
+  : m_mapping(0)
+  , m_mappingSize(0)
+  , m_data(0)
+  , m_size(0)
+  , m_open(false)
+{
+    assert(offset % std::alignment_of<T>::value == 0);
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat status;
+    if (::fstat(fd, &status) == 0 && status.st_size >= 0) {
+        const std::size_t fileSize = static_cast<std::size_t>(status.st_size);
+        if (fileSize <= offset) {
+            // Nothing to map: an empty array.
+            m_open = true;
+        } else if ((fileSize - offset) / sizeof(T) > static_cast<std::size_t>(INT_MAX)) {
+            // Too many elements to be counted by SequentialIterable::size().
+        } else {
+            void *mapping = ::mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                // The elements are typically traversed from the beginning, so
+                // let the kernel read ahead.
+                ::madvise(mapping, fileSize, MADV_SEQUENTIAL);
+                m_mapping = mapping;
+                m_mappingSize = fileSize;
+                m_data = reinterpret_cast<const T*>(static_cast<const char*>(mapping) + offset);
+                m_size = (fileSize - offset) / sizeof(T);
+                m_open = true;
+            }
+        }
+    }
+    // The mapping remains valid after the descriptor is closed.
+    ::close(fd);
+}
+
+template<typename T>
+MappedArray<T>::~MappedArray()
+{
+    unmap();
+}
+
+template<typename T>
+MappedArray<T>::MappedArray(MappedArray &&other)
+  : m_mapping(other.m_mapping)
+  , m_mappingSize(other.m_mappingSize)
+  , m_data(other.m_data)
+  , m_size(other.m_size)
+  , m_open(other.m_open)
+{
+    other.m_mapping = 0;
+    other.m_mappingSize = 0;
+    other.m_data = 0;
+    other.m_size = 0;
+    other.m_open = false;
+}
+
+template<typename T>
+MappedArray<T> &MappedArray<T>::operator=(MappedArray &&other)
+{
+    if (this != &other) {
+        unmap();
+        m_mapping = other.m_mapping;
+        m_mappingSize = other.m_mappingSize;
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_open = other.m_open;
+        other.m_mapping = 0;
+        other.m_mappingSize = 0;
+        other.m_data = 0;
+        other.m_size = 0;
+        other.m_open = false;
+    }
+    return *this;
+}
+
+template<typename T>
+void MappedArray<T>::unmap()
+{
+    if (m_mapping)
+        ::munmap(m_mapping, m_mappingSize);
+    m_mapping = 0;
+    m_mappingSize = 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+/*
+  This file is part of an example implementation of type-erased container
+  iteration
+
+  Copyright (C) 2026 Klarälvdalens Datakonsult AB, a KDAB Group company, 
+  info@kdab.com
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, 
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, 
+  this list of conditions and the following disclaimer in the documentation 
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors 
+  may be used to endorse or promote products derived from this software without 
+  specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+  LIABLE FOR   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+  CONSEQUENTIAL DAMAGES   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TYPEERASURE_PARALLEL_H
+#define TYPEERASURE_PARALLEL_H
+
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace TypeErasure
+{
+
+/**
+  @brief Chunked parallel traversal of a SequentialIterable.
+
+  Containers with the RandomAccessCapability, and containers for which
+  SequentialIterable::buildIndex() was called, are divided into chunks of
+  consecutive elements.  Worker threads repeatedly claim the next unprocessed
+  chunk, so that threads which finish early take over the remaining work
+  instead of idling.  The elements of a chunk are fetched in batches with
+  SequentialIterable::getRange().
+
+  Other containers can not be divided without walking them, so they are
+  processed sequentially on the calling thread.
+ */
+class ParallelTraversal
+{
+public:
+    enum { BatchSize = 64, ChunksPerThread = 8, MinimumChunkSize = 1024 };
+
+    ParallelTraversal(const SequentialIterable &iterable, unsigned threadCount)
+      : m_iterable(iterable)
+      , m_size(canDivide(iterable) ? iterable.size() : 0)
+      , m_threadCount(canDivide(iterable) ? threadCountFor(threadCount) : 1)
+      , m_chunkSize(std::max<int>(MinimumChunkSize, m_size / (m_threadCount * ChunksPerThread) + 1))
+      , m_chunkCount(m_size ? (m_size + m_chunkSize - 1) / m_chunkSize : 0)
+      , m_nextChunk(0)
+    {
+    }
+
+    bool isParallel() const { return m_threadCount > 1 && m_chunkCount > 1; }
+    int chunkCount() const { return m_chunkCount; }
+
+    /**
+      Call ``processChunk(chunk, first, count)`` for every chunk, from the
+      calling thread and from the worker threads.
+     */
+    template<typename ProcessChunk>
+    void run(ProcessChunk &processChunk)
+    {
+        const unsigned workerCount = std::min<unsigned>(m_threadCount, m_chunkCount) - 1;
+        std::vector<std::thread> workers;
+        workers.reserve(workerCount);
+        for (unsigned i = 0; i < workerCount; ++i)
+            workers.push_back(std::thread(&ParallelTraversal::work<ProcessChunk>, this, std::ref(processChunk)));
+        work(processChunk);
+        for (unsigned i = 0; i < workerCount; ++i)
+            workers[i].join();
+    }
+
+    /**
+      Call ``f`` with each of the ``count`` elements starting at ``first``.
+     */
+    template<typename F>
+    void forEachIn(int first, int count, F &f) const
+    {
+        const void *batch[BatchSize];
+        const MetaTypeId type = m_iterable.elementType();
+        while (count > 0) {
+            const int fetched = m_iterable.getRange(first, std::min<int>(count, BatchSize), batch);
+            for (int i = 0; i < fetched; ++i)
+                f(elementVariant(VariantData(type, batch[i])));
+            first += fetched;
+            count -= fetched;
+        }
+    }
+
+private:
+    static bool canDivide(const SequentialIterable &iterable)
+    {
+        return iterable.canRandomAccess() || iterable.hasIndex();
+    }
+
+    static unsigned threadCountFor(unsigned requested)
+    {
+        if (requested)
+            return requested;
+        // hardware_concurrency() may read the system configuration on each
+        // call, which would dominate the traversal of small containers.
+        static const unsigned hardware = std::thread::hardware_concurrency();
+        return hardware ? hardware : 1;
+    }
+
+    template<typename ProcessChunk>
+    void work(ProcessChunk &processChunk)
+    {
+        int chunk;
+        while ((chunk = m_nextChunk.fetch_add(1, std::memory_order_relaxed)) < m_chunkCount) {
+            const int first = chunk * m_chunkSize;
+            processChunk(chunk, first, std::min(m_chunkSize, m_size - first));
+        }
+    }
+
+    const SequentialIterable &m_iterable;
+    const int m_size;
+    const unsigned m_threadCount;
+    const int m_chunkSize;
+    const int m_chunkCount;
+    std::atomic<int> m_nextChunk;
+};
+
+template<typename F>
+struct ParallelForEachChunk
+{
+    const ParallelTraversal &traversal;
+    F &f;
+
+    void operator()(int, int first, int count) { traversal.forEachIn(first, count, f); }
+};
+
+/**
+  The result of one chunk of parallelReduce().  Each result is written by one
+  thread, so the results are kept in separate objects, rather than in a
+  ``std::vector<R>`` which packs ``bool`` results into shared words, and are
+  padded so that the results of different chunks do not share a cache line.
+ */
+template<typename R>
+struct ParallelReduceResult
+{
+    enum { CacheLineSize = 64 };
+
+    R value;
+    char padding[CacheLineSize];
+};
+
+template<typename R, typename F>
+struct ParallelReduceChunk
+{
+    const ParallelTraversal &traversal;
+    const R &identity;
+    F &accumulate;
+    std::vector<ParallelReduceResult<R> > &results;
+
+    void operator()(int chunk, int first, int count)
+    {
+        R result = identity;
+        struct Accumulator
+        {
+            R &result;
+            F &accumulate;
+            void operator()(const Variant &v) { result = accumulate(result, v); }
+        } accumulator = { result, accumulate };
+        traversal.forEachIn(first, count, accumulator);
+        results[chunk].value = result;
+    }
+};
+
+/**
+  Call ``f`` with each element of ``iterable`` as a ``const Variant &``.
+
+  For random-access and indexed containers the calls are made concurrently
+  from up to ``threadCount`` threads (by default, one per hardware thread),
+  in no particular order, so ``f`` must be safe to call concurrently and must
+  not throw.  Other containers are traversed sequentially on the calling
+  thread.
+ */
+template<typename F>
+void parallelForEach(const SequentialIterable &iterable, F f, unsigned threadCount = 0)
+{
+    ParallelTraversal traversal(iterable, threadCount);
+    if (!traversal.isParallel()) {
+        for (SequentialIterable::const_iterator it = iterable.begin(), end = iterable.end(); it != end; ++it)
+            f(*it);
+        return;
+    }
+    ParallelForEachChunk<F> processChunk = { traversal, f };
+    traversal.run(processChunk);
+}
+
+/**
+  Fold the elements of ``iterable`` into a value of type ``R``.
+
+  Each chunk of the container is folded, starting from ``identity``, with
+  ``accumulate(R, const Variant &)``.  The results of the chunks are then
+  folded in order with ``combine(R, R)``, so ``combine`` need only be
+  associative.  As for parallelForEach(), the functions must be safe to call
+  concurrently and must not throw, and containers which are neither
+  random-access nor indexed are folded sequentially.
+ */
+template<typename R, typename F, typename Combine>
+R parallelReduce(const SequentialIterable &iterable, R identity, F accumulate, Combine combine, unsigned threadCount = 0)
+{
+    ParallelTraversal traversal(iterable, threadCount);
+    if (!traversal.isParallel()) {
+        R result = identity;
+        for (SequentialIterable::const_iterator it = iterable.begin(), end = iterable.end(); it != end; ++it)
+            result = accumulate(result, *it);
+        return result;
+    }
+
+    const ParallelReduceResult<R> initial = { identity, {} };
+    std::vector<ParallelReduceResult<R> > results(traversal.chunkCount(), initial);
+    ParallelReduceChunk<R, F> processChunk = { traversal, identity, accumulate, results };
+    traversal.run(processChunk);
+
+    R result = identity;
+    for (typename std::vector<ParallelReduceResult<R> >::const_iterator it = results.begin(); it != results.end(); ++it)
+        result = combine(result, it->value);
+    return result;
+}
+
+}
+
+#endif
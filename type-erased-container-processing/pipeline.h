@@ -0,0 +1,253 @@
+/*
+  This file is part of an example implementation of type-erased container
+  iteration
+
+  Copyright (C) 2026 Klarälvdalens Datakonsult AB, a KDAB Group company, 
+  info@kdab.com
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, 
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, 
+  this list of conditions and the following disclaimer in the documentation 
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors 
+  may be used to endorse or promote products derived from this software without 
+  specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+  LIABLE FOR   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+  CONSEQUENTIAL DAMAGES   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TYPEERASURE_PIPELINE_H
+#define TYPEERASURE_PIPELINE_H
+
+#include "types.h"
+
+#include <type_traits>
+#include <utility>
+
+namespace TypeErasure
+{
+
+template<typename Source, typename Predicate> class FilterStage;
+template<typename Source, typename Function> class TransformStage;
+template<typename Source> class TakeStage;
+
+/**
+  @brief Single-pass input iterator over the values of a pipeline stage,
+  for use in range-for loops.
+ */
+template<typename Stage>
+class PipelineIterator
+{
+public:
+    typedef typename Stage::value_type value_type;
+
+    explicit PipelineIterator(Stage *stage) : m_stage(stage) {}
+
+    value_type operator*() const { return m_stage->current(); }
+
+    PipelineIterator &operator++()
+    {
+        if (!m_stage->next())
+            m_stage = 0;
+        return *this;
+    }
+
+    bool operator==(const PipelineIterator &other) const { return m_stage == other.m_stage; }
+    bool operator!=(const PipelineIterator &other) const { return m_stage != other.m_stage; }
+
+private:
+    Stage *m_stage;
+};
+
+/**
+  @brief Base of the stages of a lazy pipeline.
+
+  A stage produces a sequence of values on demand: next() moves to the next
+  value and returns false at the end, and current() returns the value moved
+  to.  Stages are composed with filter(), transform() and take(), each of
+  which returns a new stage holding a copy of this one, so that no
+  intermediate container is created.  The values are computed only as they
+  are pulled through the last stage.
+
+  The pipeline is traversed once, either by calling next() and current(),
+  or with a range-for loop.
+ */
+template<typename Derived>
+class PipelineStage
+{
+public:
+    template<typename Predicate>
+    FilterStage<Derived, Predicate> filter(Predicate predicate) const
+    { return FilterStage<Derived, Predicate>(derived(), predicate); }
+
+    template<typename Function>
+    TransformStage<Derived, Function> transform(Function function) const
+    { return TransformStage<Derived, Function>(derived(), function); }
+
+    TakeStage<Derived> take(int count) const
+    { return TakeStage<Derived>(derived(), count); }
+
+    PipelineIterator<Derived> begin()
+    {
+        Derived &stage = static_cast<Derived&>(*this);
+        return PipelineIterator<Derived>(stage.next() ? &stage : 0);
+    }
+
+    PipelineIterator<Derived> end()
+    { return PipelineIterator<Derived>(0); }
+
+private:
+    const Derived &derived() const { return static_cast<const Derived&>(*this); }
+};
+
+/**
+  @brief The source of a pipeline, producing the elements of a
+  SequentialIterable.
+
+  The elements are produced by the type-erased iterator operations of the
+  container, one element per call of next().
+ */
+class IterableGenerator : public PipelineStage<IterableGenerator>
+{
+public:
+    typedef Variant value_type;
+
+    explicit IterableGenerator(const SequentialIterable &iterable)
+      : m_it(iterable.begin())
+      , m_end(iterable.end())
+      , m_started(false)
+    {
+    }
+
+    bool next()
+    {
+        if (m_started)
+            ++m_it;
+        m_started = true;
+        return m_it != m_end;
+    }
+
+    value_type current() const { return *m_it; }
+
+private:
+    SequentialIterable::const_iterator m_it;
+    SequentialIterable::const_iterator m_end;
+    bool m_started;
+};
+
+/**
+  @brief Stage producing the values of ``Source`` for which ``Predicate``
+  returns true.
+ */
+template<typename Source, typename Predicate>
+class FilterStage : public PipelineStage<FilterStage<Source, Predicate> >
+{
+public:
+    typedef typename Source::value_type value_type;
+
+    FilterStage(const Source &source, Predicate predicate)
+      : m_source(source)
+      , m_predicate(predicate)
+    {
+    }
+
+    bool next()
+    {
+        while (m_source.next())
+            if (m_predicate(m_source.current()))
+                return true;
+        return false;
+    }
+
+    value_type current() const { return m_source.current(); }
+
+private:
+    Source m_source;
+    Predicate m_predicate;
+};
+
+/**
+  @brief Stage producing the result of ``Function`` for each value of
+  ``Source``.  The function is called once for each call of current().
+ */
+template<typename Source, typename Function>
+class TransformStage : public PipelineStage<TransformStage<Source, Function> >
+{
+public:
+    typedef typename std::decay<decltype(std::declval<const Function&>()(std::declval<typename Source::value_type>()))>::type value_type;
+
+    TransformStage(const Source &source, Function function)
+      : m_source(source)
+      , m_function(function)
+    {
+    }
+
+    bool next() { return m_source.next(); }
+
+    value_type current() const { return m_function(m_source.current()); }
+
+private:
+    Source m_source;
+    Function m_function;
+};
+
+/**
+  @brief Stage producing at most the first ``count`` values of ``Source``.
+  The source is not advanced beyond them.
+ */
+template<typename Source>
+class TakeStage : public PipelineStage<TakeStage<Source> >
+{
+public:
+    typedef typename Source::value_type value_type;
+
+    TakeStage(const Source &source, int count)
+      : m_source(source)
+      , m_remaining(count)
+    {
+    }
+
+    bool next()
+    {
+        if (m_remaining <= 0)
+            return false;
+        --m_remaining;
+        return m_source.next();
+    }
+
+    value_type current() const { return m_source.current(); }
+
+private:
+    Source m_source;
+    int m_remaining;
+};
+
+/**
+  Returns the source of a lazy pipeline over the elements of ``iterable``.
+ */
+IterableGenerator generate(const SequentialIterable &iterable)
+{
+    return IterableGenerator(iterable);
+}
+
+}
+
+#endif
@@ -0,0 +1,353 @@
+/*
+  This file is part of an example implementation of type-erased container
+  iteration
+
+  Copyright (C) 2026 Klarälvdalens Datakonsult AB, a KDAB Group company, 
+  info@kdab.com
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, 
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, 
+  this list of conditions and the following disclaimer in the documentation 
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors 
+  may be used to endorse or promote products derived from this software without 
+  specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+  LIABLE FOR   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+  CONSEQUENTIAL DAMAGES   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TYPEERASURE_REDUCTIONS_H
+#define TYPEERASURE_REDUCTIONS_H
+
+#include "types.h"
+
+#include <functional>
+
+namespace TypeErasure
+{
+
+/**
+  The comparison of each element against a value in countIf().
+ */
+enum Comparison
+{
+    Less,
+    LessEqual,
+    Equal,
+    NotEqual,
+    GreaterEqual,
+    Greater
+};
+
+/**
+  @brief Table of the reductions for one arithmetic element type.
+
+  The kernels of the element type of a container are looked up once by its
+  runtime type id (see reductionKernels()).  Each kernel then works on the
+  strongly-typed elements: contiguous containers are processed directly in
+  memory, in loops which are written so that the compiler can vectorize
+  them, and other containers are walked with SequentialIterable::visit().
+ */
+struct ReductionKernels
+{
+    typedef bool (*sumFunc)(const SequentialIterable &iterable, double *result);
+    typedef bool (*extremumFunc)(const SequentialIterable &iterable, double *result);
+    typedef int (*countIfFunc)(const SequentialIterable &iterable, Comparison comparison, double value);
+    typedef int (*findFunc)(const SequentialIterable &iterable, double value);
+
+    MetaTypeId _metaType_id;
+    sumFunc _sum;
+    extremumFunc _min;
+    extremumFunc _max;
+    countIfFunc _countIf;
+    findFunc _find;
+};
+
+/**
+  The type in which elements of type ``T`` are summed.  Integers are summed
+  exactly, and floating point numbers in double precision.
+ */
+template<typename T, bool = std::is_floating_point<T>::value, bool = std::is_signed<T>::value>
+struct SumType { typedef double type; };
+
+template<typename T>
+struct SumType<T, false, true> { typedef long long type; };
+
+template<typename T>
+struct SumType<T, false, false> { typedef unsigned long long type; };
+
+template<typename T>
+struct ReductionKernelsFor
+{
+    typedef typename SumType<T>::type Sum;
+
+    // The number of independent partial results in the contiguous loops.
+    // Separate accumulators allow floating point reductions to be
+    // vectorized without reassociating a single sum.
+    enum { Lanes = 8, FindBlockSize = 32 };
+
+    static Sum sumContiguous(const T *data, int n)
+    {
+        Sum partial[Lanes] = {};
+        int i = 0;
+        for ( ; i + Lanes <= n; i += Lanes)
+            for (int lane = 0; lane < Lanes; ++lane)
+                partial[lane] += data[i + lane];
+        Sum total = 0;
+        for ( ; i < n; ++i)
+            total += data[i];
+        for (int lane = 0; lane < Lanes; ++lane)
+            total += partial[lane];
+        return total;
+    }
+
+    struct SumVisitor
+    {
+        Sum total;
+        void operator()(T t) { total += t; }
+    };
+
+    static bool sum(const SequentialIterable &iterable, double *result)
+    {
+        if (iterable.isContiguous()) {
+            *result = static_cast<double>(sumContiguous(static_cast<const T*>(iterable.data()), iterable.size()));
+            return true;
+        }
+        SumVisitor visitor = { 0 };
+        iterable.visit<T>(visitor);
+        *result = static_cast<double>(visitor.total);
+        return true;
+    }
+
+    template<typename Select>
+    static T extremumContiguous(const T *data, int n)
+    {
+        const Select select;
+        T partial[Lanes];
+        for (int lane = 0; lane < Lanes; ++lane)
+            partial[lane] = data[0];
+        int i = 0;
+        for ( ; i + Lanes <= n; i += Lanes)
+            for (int lane = 0; lane < Lanes; ++lane)
+                partial[lane] = select(data[i + lane], partial[lane]) ? data[i + lane] : partial[lane];
+        T result = partial[0];
+        for ( ; i < n; ++i)
+            result = select(data[i], result) ? data[i] : result;
+        for (int lane = 1; lane < Lanes; ++lane)
+            result = select(partial[lane], result) ? partial[lane] : result;
+        return result;
+    }
+
+    template<typename Select>
+    struct ExtremumVisitor
+    {
+        bool found;
+        T result;
+        void operator()(T t)
+        {
+            if (!found || Select()(t, result))
+                result = t;
+            found = true;
+        }
+    };
+
+    template<typename Select>
+    static bool extremum(const SequentialIterable &iterable, double *result)
+    {
+        if (iterable.isContiguous()) {
+            const int n = iterable.size();
+            if (n == 0)
+                return false;
+            *result = static_cast<double>(extremumContiguous<Select>(static_cast<const T*>(iterable.data()), n));
+            return true;
+        }
+        ExtremumVisitor<Select> visitor = { false, T() };
+        iterable.visit<T>(visitor);
+        if (visitor.found)
+            *result = static_cast<double>(visitor.result);
+        return visitor.found;
+    }
+
+    static bool min(const SequentialIterable &iterable, double *result)
+    { return extremum<std::less<T> >(iterable, result); }
+
+    static bool max(const SequentialIterable &iterable, double *result)
+    { return extremum<std::greater<T> >(iterable, result); }
+
+    template<typename Compare>
+    struct CountVisitor
+    {
+        double value;
+        int count;
+        void operator()(T t) { count += Compare()(static_cast<double>(t), value); }
+    };
+
+    template<typename Compare>
+    static int countIfAs(const SequentialIterable &iterable, double value)
+    {
+        const Compare compare;
+        if (iterable.isContiguous()) {
+            const T *data = static_cast<const T*>(iterable.data());
+            const int n = iterable.size();
+            int count = 0;
+            for (int i = 0; i < n; ++i)
+                count += compare(static_cast<double>(data[i]), value);
+            return count;
+        }
+        CountVisitor<Compare> visitor = { value, 0 };
+        iterable.visit<T>(visitor);
+        return visitor.count;
+    }
+
+    static int countIf(const SequentialIterable &iterable, Comparison comparison, double value)
+    {
+        switch (comparison) {
+        case Less: return countIfAs<std::less<double> >(iterable, value);
+        case LessEqual: return countIfAs<std::less_equal<double> >(iterable, value);
+        case Equal: return countIfAs<std::equal_to<double> >(iterable, value);
+        case NotEqual: return countIfAs<std::not_equal_to<double> >(iterable, value);
+        case GreaterEqual: return countIfAs<std::greater_equal<double> >(iterable, value);
+        case Greater: return countIfAs<std::greater<double> >(iterable, value);
+        }
+        assert(!"Unknown comparison");
+        return 0;
+    }
+
+    static int find(const SequentialIterable &iterable, double value)
+    {
+        if (iterable.isContiguous()) {
+            // Test whole blocks without an early exit, which can be
+            // vectorized, and only search within the block which matched.
+            const T *data = static_cast<const T*>(iterable.data());
+            const int n = iterable.size();
+            int block = 0;
+            for ( ; block + FindBlockSize <= n; block += FindBlockSize) {
+                bool match = false;
+                for (int i = block; i < block + FindBlockSize; ++i)
+                    match |= static_cast<double>(data[i]) == value;
+                if (match)
+                    break;
+            }
+            for (int i = block; i < n; ++i)
+                if (static_cast<double>(data[i]) == value)
+                    return i;
+            return -1;
+        }
+        int index = 0;
+        for (SequentialIterable::const_iterator it = iterable.begin(), end = iterable.end(); it != end; ++it, ++index)
+            if (static_cast<double>((*it).template asRef<T>()) == value)
+                return index;
+        return -1;
+    }
+
+    static constexpr ReductionKernels table = {
+        TypeErasure::metaTypeId<T>(),
+        sum,
+        min,
+        max,
+        countIf,
+        find
+    };
+};
+
+template<typename T>
+constexpr ReductionKernels ReductionKernelsFor<T>::table;
+
+/**
+  Returns the reductions for the element type of ``iterable``, or null if
+  the element type is not one of the built-in arithmetic types.
+ */
+const ReductionKernels *reductionKernels(const SequentialIterable &iterable)
+{
+    static const ReductionKernels * const kernels[] = {
+        &ReductionKernelsFor<int>::table,
+        &ReductionKernelsFor<double>::table,
+        &ReductionKernelsFor<float>::table,
+        &ReductionKernelsFor<long long>::table,
+        &ReductionKernelsFor<long>::table,
+        &ReductionKernelsFor<short>::table,
+        &ReductionKernelsFor<unsigned>::table,
+        &ReductionKernelsFor<unsigned long long>::table,
+        &ReductionKernelsFor<unsigned long>::table,
+        &ReductionKernelsFor<unsigned short>::table
+    };
+
+    const MetaTypeId type = iterable.elementType();
+    for (std::size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i)
+        if (kernels[i]->_metaType_id == type)
+            return kernels[i];
+    return 0;
+}
+
+/**
+  Store the sum of the elements in ``result``.  Returns false if the element
+  type is not arithmetic.  Integers are summed exactly before the conversion
+  to double.
+ */
+bool sum(const SequentialIterable &iterable, double *result)
+{
+    const ReductionKernels *kernels = reductionKernels(iterable);
+    return kernels && kernels->_sum(iterable, result);
+}
+
+/**
+  Store the smallest element in ``result``.  Returns false if the element
+  type is not arithmetic or if the container is empty.
+ */
+bool min(const SequentialIterable &iterable, double *result)
+{
+    const ReductionKernels *kernels = reductionKernels(iterable);
+    return kernels && kernels->_min(iterable, result);
+}
+
+/**
+  Store the largest element in ``result``.  Returns false if the element
+  type is not arithmetic or if the container is empty.
+ */
+bool max(const SequentialIterable &iterable, double *result)
+{
+    const ReductionKernels *kernels = reductionKernels(iterable);
+    return kernels && kernels->_max(iterable, result);
+}
+
+/**
+  Returns the number of elements for which ``element comparison value`` is
+  true, or -1 if the element type is not arithmetic.
+ */
+int countIf(const SequentialIterable &iterable, Comparison comparison, double value)
+{
+    const ReductionKernels *kernels = reductionKernels(iterable);
+    return kernels ? kernels->_countIf(iterable, comparison, value) : -1;
+}
+
+/**
+  Returns the index of the first element equal to ``value``, or -1 if there
+  is none or if the element type is not arithmetic.
+ */
+int find(const SequentialIterable &iterable, double value)
+{
+    const ReductionKernels *kernels = reductionKernels(iterable);
+    return kernels ? kernels->_find(iterable, value) : -1;
+}
+
+}
+
+#endif
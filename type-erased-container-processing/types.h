@@ -35,15 +35,70 @@
   POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <typeinfo>
-#include <map>
+#ifndef TYPEERASURE_TYPES_H
+#define TYPEERASURE_TYPES_H
+
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 #include <assert.h>
 
 namespace TypeErasure
 {
 
+/**
+  @brief Runtime type identifier.
+
+  The id of a type is the address of a static object specific to that type
+  (see metaTypeId()).  Unlike ``typeid(T).hash_code()``, which may hash the
+  name of the type and is not guaranteed to be unique, obtaining an id costs
+  nothing at runtime, ids of different types never collide, and comparing
+  ids is a single pointer comparison.
+
+  The static object is emitted with vague linkage and merged by the linker,
+  so the id is the same in every translation unit of a program.  Libraries
+  which hide the symbols of template instantiations may have ids which
+  differ from those of the program using them.  As the id is an address, it
+  is not stable between processes.
+ */
+typedef const void *MetaTypeId;
+
+/**
+  The tag is deliberately not const: identical constant data may be folded
+  into one object by the linker (as with MSVC ``/OPT:ICF`` or
+  ``-fmerge-all-constants``), which would give different types the same id,
+  whereas writable objects always have distinct addresses.
+ */
+template<typename T>
+struct MetaTypeIdTag
+{
+    static char tag;
+};
+
+template<typename T>
+char MetaTypeIdTag<T>::tag = 0;
+
+/**
+  Returns the runtime type id of ``T``.  As for ``typeid``, top-level
+  cv-qualifiers are ignored.
+ */
+template<typename T>
+constexpr MetaTypeId metaTypeId()
+{
+    return &MetaTypeIdTag<typename std::remove_cv<T>::type>::tag;
+}
+
 /**
   @brief Structure of void pointer and runtime type id.
 
@@ -58,24 +113,280 @@ namespace TypeErasure
  */
 struct VariantData
 {
-    VariantData(const std::size_t metaTypeId_,
+    VariantData(const MetaTypeId metaTypeId_,
                 const void *data_)
       : metaTypeId(metaTypeId_)
       , data(data_)
     {
     }
-    const std::size_t metaTypeId;
+    const MetaTypeId metaTypeId;
     const void *data;
 };
 
+#ifdef TYPEERASURE_INSTRUMENTATION
+
+/**
+  @brief Counters of the costly operations of the type-erasure layer.
+
+  The counters are only compiled in if ``TYPEERASURE_INSTRUMENTATION`` is
+  defined, which must then be done consistently for all translation units.
+  They are updated with relaxed atomic operations and read through
+  instrumentationSnapshot().
+ */
+struct InstrumentationCounters
+{
+    std::atomic<unsigned long long> registryInserts;
+    std::atomic<unsigned long long> registryLookups;
+    std::atomic<unsigned long long> heapIterators;
+    std::atomic<unsigned long long> iteratorCopies;
+    std::atomic<unsigned long long> atCalls;
+    std::atomic<unsigned long long> atAdvanceDistance;
+};
+
+/**
+  Counters of the use of one container type.  ``iterations`` counts the
+  iterators moved to the beginning of a container, and ``steps`` the
+  elements advanced over or fetched by them.
+ */
+struct TypeInstrumentationCounters
+{
+    std::atomic<unsigned long long> iterations;
+    std::atomic<unsigned long long> steps;
+};
+
+InstrumentationCounters instrumentationCounters;
+
+#define TYPEERASURE_COUNT(counter, n) \
+    TypeErasure::instrumentationCounters.counter.fetch_add(n, std::memory_order_relaxed)
+#define TYPEERASURE_COUNT_TYPE(T, counter, n) \
+    OperationsFor<T>::counters.counter.fetch_add(n, std::memory_order_relaxed)
+
+#else
+
+#define TYPEERASURE_COUNT(counter, n) ((void)0)
+#define TYPEERASURE_COUNT_TYPE(T, counter, n) ((void)0)
+
+#endif
+
+/**
+  @brief Type-erased storage for an iterator.
+
+  Either holds a small iterator inline in ``buffer``, or holds in ``ptr`` the
+  address of a heap-allocated iterator or of the element pointed to.  Which of
+  the forms is used is determined at compile time by StoreIteratorInline and
+  the IteratorAPI implementation selected from it.
+
+  The buffer is large enough for the iterators of the standard containers,
+  which are typically one to four pointers in size.
+ */
+union IteratorStorage
+{
+    void *ptr;
+    unsigned char buffer[4 * sizeof(void*)];
+};
+
+/**
+  Whether an iterator of type ``const_iterator`` may be stored inline in
+  IteratorStorage.  The iterator must fit in the buffer, must be nothrow
+  copy and move constructible, and must be trivially destructible, because
+  the storage is discarded without a destructor call, so that no
+  bookkeeping (as done by checked iterators) may be lost.  Iterators which
+  are not trivially copyable are relocated with their move constructor.
+ */
+template<typename const_iterator>
+struct StoreIteratorInline
+  : std::integral_constant<bool, sizeof(const_iterator) <= sizeof(IteratorStorage)
+                              && alignof(const_iterator) <= alignof(IteratorStorage)
+                              && std::is_nothrow_copy_constructible<const_iterator>::value
+                              && std::is_nothrow_move_constructible<const_iterator>::value
+                              && std::is_trivially_destructible<const_iterator>::value>
+{
+};
+
+/**
+  @brief Bump allocator for the iterators which are not stored inline.
+
+  Allocation only advances a pointer within the current block of memory, and
+  individual allocations are never freed.  All the memory is reclaimed at
+  once by reset(), when no iterator allocated from the arena is alive any
+  more.  An arena is not thread-safe; forCurrentThread() returns an arena
+  for each thread, so that short-lived iterations do not contend on the
+  global heap.
+
+  An arena is used for the iterators created by a SequentialIterable after
+  SequentialIterable::setIteratorArena().  Copies of those iterators are
+  allocated from the same arena.
+ */
+class IteratorArena
+{
+public:
+    enum { DefaultBlockSize = 4096 };
+
+    explicit IteratorArena(std::size_t blockSize = DefaultBlockSize)
+      : m_blocks(0)
+      , m_current(0)
+      , m_end(0)
+      , m_blockSize(blockSize)
+    {
+    }
+
+    ~IteratorArena()
+    {
+        release(0);
+    }
+
+    void *allocate(std::size_t size, std::size_t alignment)
+    {
+        std::uintptr_t address = alignUp(m_current, alignment);
+        if (!m_current || address + size > reinterpret_cast<std::uintptr_t>(m_end)) {
+            addBlock(size + alignment);
+            address = alignUp(m_current, alignment);
+        }
+        m_current = reinterpret_cast<unsigned char*>(address + size);
+        return reinterpret_cast<void*>(address);
+    }
+
+    /**
+      Reclaim all allocations.  The most recent block is kept for reuse.
+     */
+    void reset()
+    {
+        if (!m_blocks)
+            return;
+        release(m_blocks);
+        m_blocks->next = 0;
+        m_current = m_blocks->data();
+        m_end = m_current + m_blocks->size;
+    }
+
+    static IteratorArena &forCurrentThread()
+    {
+        static thread_local IteratorArena arena;
+        return arena;
+    }
+
+private:
+    struct BlockHeader
+    {
+        BlockHeader *next;
+        std::size_t size;
+        unsigned char *data() { return reinterpret_cast<unsigned char*>(this + 1); }
+    };
+
+    static std::uintptr_t alignUp(const unsigned char *p, std::size_t alignment)
+    {
+        return (reinterpret_cast<std::uintptr_t>(p) + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+    }
+
+    void addBlock(std::size_t minimumSize)
+    {
+        const std::size_t size = minimumSize > m_blockSize ? minimumSize : m_blockSize;
+        BlockHeader *block = static_cast<BlockHeader*>(::operator new(sizeof(BlockHeader) + size));
+        block->next = m_blocks;
+        block->size = size;
+        m_blocks = block;
+        m_current = block->data();
+        m_end = m_current + size;
+    }
+
+    // Free the blocks other than ``keep``.
+    void release(BlockHeader *keep)
+    {
+        BlockHeader *block = m_blocks;
+        while (block) {
+            BlockHeader *next = block->next;
+            if (block != keep)
+                ::operator delete(block);
+            block = next;
+        }
+        m_blocks = keep;
+        if (!keep)
+            m_current = m_end = 0;
+    }
+
+    IteratorArena(const IteratorArena &);
+    IteratorArena &operator=(const IteratorArena &);
+
+    BlockHeader *m_blocks;
+    unsigned char *m_current;
+    unsigned char *m_end;
+    const std::size_t m_blockSize;
+};
+
+/**
+  Advance ``it`` by ``step`` elements, but not beyond ``end``, and return
+  the number of elements advanced.  Random-access iterators are moved by
+  one addition, other iterators are incremented one element at a time.
+ */
+template<typename Iterator>
+int advanceBounded(Iterator &it, const Iterator &end, int step, std::random_access_iterator_tag)
+{
+    const int remaining = static_cast<int>(end - it);
+    if (step > remaining)
+        step = remaining;
+    it += step;
+    return step;
+}
+
+template<typename Iterator, typename Category>
+int advanceBounded(Iterator &it, const Iterator &end, int step, Category)
+{
+    int advanced = 0;
+    for ( ; advanced < step && it != end; ++advanced)
+        ++it;
+    return advanced;
+}
+
+template<typename Iterator>
+int advanceBounded(Iterator &it, const Iterator &end, int step)
+{
+    return advanceBounded(it, end, step, typename std::iterator_traits<Iterator>::iterator_category());
+}
+
+#if defined(__GNUC__)
+#define TYPEERASURE_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define TYPEERASURE_PREFETCH(address) ((void)(address))
+#endif
+
+enum { PrefetchDistance = 8 };
+
+/**
+  Call ``f`` with the address of each element in [it, end), as returned by
+  ``API::getData()``, and return the number of elements.
+
+  A second iterator runs PrefetchDistance elements ahead and issues a
+  software prefetch of each element it passes, so that the elements of
+  node-based containers are already being loaded by the time they are
+  reached.
+ */
+template<typename API, typename Iterator, typename F>
+int forEachPrefetching(Iterator it, const Iterator &end, F &f)
+{
+    Iterator ahead = it;
+    for (int i = 0; i < PrefetchDistance && ahead != end; ++i, ++ahead)
+        TYPEERASURE_PREFETCH(API::getData(ahead));
+    int count = 0;
+    for ( ; it != end; ++it, ++count) {
+        if (ahead != end) {
+            TYPEERASURE_PREFETCH(API::getData(ahead));
+            ++ahead;
+        }
+        f(API::getData(it));
+    }
+    return count;
+}
+
 /**
   @brief Iterator operation abstraction
 
   An implementation of IteratorAPI for containers whose const_iterator is a
-  standalone class, not simply a pointer to a contained element.
+  standalone class, not simply a pointer to a contained element, and which
+  is too large or too complex to be stored inline.
 
   It is therefore necessary to copy-construct const_iterator types on the heap
-  and manage the memory by deleting appropriately.
+  and manage the memory by deleting appropriately.  The memory is taken from
+  an IteratorArena instead of the global heap if one is given.
 
   Accessing the actual data in getData() may require de-referencing the pointer to
   the iterator, then de-referencing the actual iterator and retrieving the
@@ -85,32 +396,171 @@ struct VariantData
   These methods implement [Disclosure 4] through the use of algorithms such as
   ``std::advance`` and other operations on iterators.
  */
-template<typename const_iterator>
+template<typename const_iterator, bool Inline = StoreIteratorInline<const_iterator>::value>
 struct IteratorAPI
 {
-    static void assign(void **ptr, const_iterator iterator)
+    /**
+      Whether the storage may be relocated byte for byte.  Only the address
+      of the heap allocation is stored, so it always may.
+     */
+    enum { BitwiseRelocatable = true };
+
+    /**
+      The heap allocation of an iterator, which records the arena it was
+      allocated from, or null for the global heap.
+     */
+    struct Block
+    {
+        IteratorArena *arena;
+        const_iterator iterator;
+    };
+
+    static const_iterator *iteratorFor(IteratorStorage *storage)
     {
-        *ptr = new const_iterator(iterator);
+        return &static_cast<Block*>(storage->ptr)->iterator;
     }
-    static void assign(void **ptr, void * const * src)
+    static const const_iterator *iteratorFor(const IteratorStorage *storage)
     {
-        *ptr = new const_iterator(*static_cast<const_iterator*>(*src));
+        return &static_cast<const Block*>(storage->ptr)->iterator;
     }
 
-    static void advance(void **iterator, int step)
+    static void assign(IteratorStorage *storage, const_iterator iterator, IteratorArena *arena = 0)
     {
-        const_iterator &it = *static_cast<const_iterator*>(*iterator);
-        std::advance(it, step);
+        TYPEERASURE_COUNT(heapIterators, 1);
+        void *memory = arena ? arena->allocate(sizeof(Block), std::alignment_of<Block>::value)
+                             : ::operator new(sizeof(Block));
+        Block block = { arena, iterator };
+        storage->ptr = new (memory) Block(block);
+    }
+    static void assign(IteratorStorage *storage, const IteratorStorage *src)
+    {
+        if (!src->ptr) {
+            storage->ptr = 0;
+            return;
+        }
+        assign(storage, *iteratorFor(src), static_cast<const Block*>(src->ptr)->arena);
+    }
+    static void relocate(IteratorStorage *storage, IteratorStorage *src)
+    {
+        storage->ptr = src->ptr;
+        src->ptr = 0;
+    }
+
+    static void advance(IteratorStorage *iterator, int step)
+    {
+        std::advance(*iteratorFor(iterator), step);
+    }
+
+    static int advanceBounded(IteratorStorage *iterator, const IteratorStorage *end, int step)
+    {
+        return TypeErasure::advanceBounded(*iteratorFor(iterator), *iteratorFor(end), step);
+    }
+
+    static const_iterator get(const IteratorStorage *iterator)
+    {
+        return *iteratorFor(iterator);
+    }
+
+    /**
+      Destroy the iterator.  Memory from an arena is only released when the
+      arena is reset.
+     */
+    static void destroy(IteratorStorage *storage)
+    {
+        Block *block = static_cast<Block*>(storage->ptr);
+        if (block) {
+            IteratorArena * const arena = block->arena;
+            block->~Block();
+            if (!arena)
+                ::operator delete(block);
+        }
+        storage->ptr = 0;
+    }
+
+    static const void *getData(const IteratorStorage *iterator)
+    {
+        return &**iteratorFor(iterator);
+    }
+
+    static const void *getData(const_iterator it)
+    {
+        return &*it;
+    }
+
+    static bool equal(const IteratorStorage *it, const IteratorStorage *other)
+    {
+        return *iteratorFor(it) == *iteratorFor(other);
+    }
+};
+
+/**
+  @brief Iterator operation abstraction
+
+  An implementation of IteratorAPI for containers whose const_iterator is a
+  standalone class which is small enough and simple enough to be stored inline
+  in the IteratorStorage.
+
+  The iterator is copy-constructed in place in the storage buffer, so no heap
+  allocation is needed to assign it, and 'deletion' only runs the (trivial)
+  destructor.  Iterators which are not trivially copyable, such as those of
+  ``std::deque``, are moved into the buffer with their move constructor when
+  the storage is relocated.
+
+  This is the implementation of [Disclosure 6] and relates to [Disclosure 5].
+  These methods implement [Disclosure 4] through the use of algorithms such as
+  ``std::advance`` and other operations on iterators.
+ */
+template<typename const_iterator>
+struct IteratorAPI<const_iterator, true>
+{
+    enum { BitwiseRelocatable = std::is_trivially_copyable<const_iterator>::value };
+
+    static const_iterator *iteratorFor(IteratorStorage *storage)
+    {
+        return static_cast<const_iterator*>(static_cast<void*>(storage->buffer));
+    }
+    static const const_iterator *iteratorFor(const IteratorStorage *storage)
+    {
+        return static_cast<const const_iterator*>(static_cast<const void*>(storage->buffer));
+    }
+
+    static void assign(IteratorStorage *storage, const_iterator iterator, IteratorArena * = 0)
+    {
+        new (storage->buffer) const_iterator(iterator);
+    }
+    static void assign(IteratorStorage *storage, const IteratorStorage *src)
+    {
+        new (storage->buffer) const_iterator(*iteratorFor(src));
+    }
+    static void relocate(IteratorStorage *storage, IteratorStorage *src)
+    {
+        new (storage->buffer) const_iterator(std::move(*iteratorFor(src)));
+        destroy(src);
+    }
+
+    static void advance(IteratorStorage *iterator, int step)
+    {
+        std::advance(*iteratorFor(iterator), step);
+    }
+
+    static int advanceBounded(IteratorStorage *iterator, const IteratorStorage *end, int step)
+    {
+        return TypeErasure::advanceBounded(*iteratorFor(iterator), *iteratorFor(end), step);
+    }
+
+    static const_iterator get(const IteratorStorage *iterator)
+    {
+        return *iteratorFor(iterator);
     }
 
-    static void destroy(void **ptr)
+    static void destroy(IteratorStorage *storage)
     {
-        delete static_cast<const_iterator*>(*ptr);
+        iteratorFor(storage)->~const_iterator();
     }
 
-    static const void *getData(void * const *iterator)
+    static const void *getData(const IteratorStorage *iterator)
     {
-        return &**static_cast<const_iterator*>(*iterator);
+        return &**iteratorFor(iterator);
     }
 
     static const void *getData(const_iterator it)
@@ -118,11 +568,12 @@ struct IteratorAPI
         return &*it;
     }
 
-    static bool equal(void * const *it, void * const *other)
+    static bool equal(const IteratorStorage *it, const IteratorStorage *other)
     {
-        return *static_cast<const_iterator*>(*it) == *static_cast<const_iterator*>(*other);
+        return *iteratorFor(it) == *iteratorFor(other);
     }
 };
+
 /**
   @brief Iterator operation abstraction
 
@@ -142,31 +593,51 @@ struct IteratorAPI
   ``std::advance`` and other operations on iterators.
  */
 template<typename value_type>
-struct IteratorAPI<const value_type*>
+struct IteratorAPI<const value_type*, true>
 {
-    static void assign(void **ptr, const value_type *iterator )
+    enum { BitwiseRelocatable = true };
+
+    static void assign(IteratorStorage *storage, const value_type *iterator, IteratorArena * = 0)
+    {
+        storage->ptr = const_cast<value_type*>(iterator);
+    }
+    static void assign(IteratorStorage *storage, const IteratorStorage *src)
     {
-        *ptr = const_cast<value_type*>(iterator);
+        storage->ptr = src->ptr;
     }
-    static void assign(void **ptr, void * const * src)
+    static void relocate(IteratorStorage *storage, IteratorStorage *src)
     {
-        *ptr = static_cast<value_type*>(*src);
+        storage->ptr = src->ptr;
+        src->ptr = 0;
     }
 
-    static void advance(void **iterator, int step)
+    static void advance(IteratorStorage *iterator, int step)
     {
-        value_type *it = static_cast<value_type*>(*iterator);
+        value_type *it = static_cast<value_type*>(iterator->ptr);
         std::advance(it, step);
-        *iterator = it;
+        iterator->ptr = it;
     }
 
-    static void destroy(void **)
+    static int advanceBounded(IteratorStorage *iterator, const IteratorStorage *end, int step)
     {
+        const value_type *it = get(iterator);
+        const int advanced = TypeErasure::advanceBounded(it, get(end), step);
+        iterator->ptr = const_cast<value_type*>(it);
+        return advanced;
     }
 
-    static const void *getData(void * const *iterator)
+    static const value_type *get(const IteratorStorage *iterator)
     {
-        return *iterator;
+        return static_cast<const value_type*>(iterator->ptr);
+    }
+
+    static void destroy(IteratorStorage *)
+    {
+    }
+
+    static const void *getData(const IteratorStorage *iterator)
+    {
+        return iterator->ptr;
     }
 
     static const void *getData(const value_type *it)
@@ -174,16 +645,44 @@ struct IteratorAPI<const value_type*>
         return it;
     }
 
-    static bool equal(void * const *it, void * const *other)
+    static bool equal(const IteratorStorage *it, const IteratorStorage *other)
     {
-        return static_cast<value_type*>(*it) == static_cast<value_type*>(*other);
+        return static_cast<value_type*>(it->ptr) == static_cast<value_type*>(other->ptr);
     }
 };
 
+/**
+  @brief Access to the iterator type, element type and bounds of a container.
+
+  The default implementation uses the nested types and the ``begin()`` and
+  ``end()`` members of standard containers.  It is specialized for C arrays,
+  and may be specialized for other containers.
+ */
+template<typename T>
+struct ContainerTraits
+{
+    typedef typename T::const_iterator const_iterator;
+    typedef typename T::value_type value_type;
+
+    static const_iterator begin(const T *t) { return t->begin(); }
+    static const_iterator end(const T *t) { return t->end(); }
+};
+
+template<typename T, std::size_t N>
+struct ContainerTraits<T[N]>
+{
+    typedef const T *const_iterator;
+    typedef T value_type;
+
+    static const_iterator begin(const T (*t)[N]) { return *t; }
+    static const_iterator end(const T (*t)[N]) { return *t + N; }
+};
+
 /**
   Capabilities which map to some standard concepts for recording and use at
   runtime.  This allows runtime determination of whether it is possible to
-  perform backwards or random iteration with the container.
+  perform backwards or random iteration with the container, or to access its
+  elements directly in memory.
 
   As it relates to API for use by downstreams, this relates to [Disclosure 7]
  */
@@ -191,310 +690,2590 @@ enum IteratorCapability
 {
     ForwardCapability = 1,
     BiDirectionalCapability = 2,
-    RandomAccessCapability = 4
+    RandomAccessCapability = 4,
+    ContiguousCapability = 8
 };
 
-template<typename T, typename Category = typename std::iterator_traits<typename T::const_iterator>::iterator_category>
-struct CapabilitiesImpl;
+/**
+  @brief Detection of containers which store their elements contiguously.
 
+  Containers whose const_iterator is a pointer, and containers with a
+  ``data()`` member returning a pointer to the element type (such as
+  ``std::vector`` and ``std::array``, but not ``std::vector<bool>``) are
+  contiguous.  The data() method returns the address of the first element.
+ */
 template<typename T>
-struct CapabilitiesImpl<T, std::forward_iterator_tag>
-{ enum { IteratorCapabilities = ForwardCapability }; };
+struct HasDataMember
+{
+    template<typename U>
+    static char test(typename std::enable_if<std::is_same<decltype(std::declval<const U&>().data()),
+                                                          const typename ContainerTraits<U>::value_type*>::value>::type*);
+    template<typename U>
+    static long test(...);
+
+    enum { value = sizeof(test<T>(0)) == sizeof(char) };
+};
+
+template<typename T,
+         int Kind = HasDataMember<T>::value ? 2
+                  : std::is_pointer<typename ContainerTraits<T>::const_iterator>::value ? 1 : 0>
+struct ContiguousStorage
+{
+    enum { IsContiguous = 0 };
+    static const void *data(const T *) { return 0; }
+};
+
+template<typename T>
+struct ContiguousStorage<T, 1>
+{
+    enum { IsContiguous = 1 };
+    static const void *data(const T *t) { return ContainerTraits<T>::begin(t); }
+};
+
 template<typename T>
-struct CapabilitiesImpl<T, std::bidirectional_iterator_tag>
+struct ContiguousStorage<T, 2>
+{
+    enum { IsContiguous = 1 };
+    static const void *data(const T *t) { return t->data(); }
+};
+
+template<typename T,
+         typename Category = typename std::iterator_traits<typename ContainerTraits<T>::const_iterator>::iterator_category,
+         bool Contiguous = ContiguousStorage<T>::IsContiguous>
+struct CapabilitiesImpl;
+
+template<typename T, bool Contiguous>
+struct CapabilitiesImpl<T, std::forward_iterator_tag, Contiguous>
+{ enum { IteratorCapabilities = ForwardCapability }; };
+template<typename T, bool Contiguous>
+struct CapabilitiesImpl<T, std::bidirectional_iterator_tag, Contiguous>
 { enum { IteratorCapabilities = BiDirectionalCapability | ForwardCapability }; };
 template<typename T>
-struct CapabilitiesImpl<T, std::random_access_iterator_tag>
+struct CapabilitiesImpl<T, std::random_access_iterator_tag, false>
 { enum { IteratorCapabilities = RandomAccessCapability | BiDirectionalCapability | ForwardCapability }; };
+template<typename T>
+struct CapabilitiesImpl<T, std::random_access_iterator_tag, true>
+{ enum { IteratorCapabilities = ContiguousCapability | RandomAccessCapability | BiDirectionalCapability | ForwardCapability }; };
 
+/**
+  @brief Detection of containers with a ``size()`` member.
+
+  Standard containers other than ``std::forward_list`` provide a
+  constant-time ``size()`` member, which is used instead of counting the
+  elements.
+ */
 template<typename T>
-struct ContainerAPI : CapabilitiesImpl<T>
+struct HasSizeMember
+{
+    template<typename U>
+    static char test(typename std::enable_if<std::is_integral<decltype(std::declval<const U&>().size())>::value>::type*);
+    template<typename U>
+    static long test(...);
+
+    enum { value = sizeof(test<T>(0)) == sizeof(char) };
+};
+
+template<typename T, bool = HasSizeMember<T>::value>
+struct SizeImpl
 {
+    enum { HasCheapSize = std::is_base_of<std::random_access_iterator_tag,
+                                          typename std::iterator_traits<typename ContainerTraits<T>::const_iterator>::iterator_category>::value };
+
     /**
       This method implements [Disclosure 4] through the use of the
-      ``std::distance`` algorithm.  The ContainerAPI template may be
-      specialized for particular containers which may implement a more-efficient
-      way to determine the size.
+      ``std::distance`` algorithm, which is constant-time only for
+      random-access iterators.
     */
-    static int size(const T *t) { return std::distance(t->begin(), t->end()); }
+    static int size(const T *t) { return std::distance(ContainerTraits<T>::begin(t), ContainerTraits<T>::end(t)); }
 };
 
-/**
-  @brief Structure of reference to a container data and operations to perform on it.
+template<typename T>
+struct SizeImpl<T, true>
+{
+    enum { HasCheapSize = 1 };
+    static int size(const T *t) { return static_cast<int>(t->size()); }
+};
 
-  Store a type-erased immutable reference to the container, the runtime-id of the type of
-  the elements in the container, the capabilities so that usable API may be
-  determined at runtime, function pointers for relevant operations, and a
-  mutable location to store a type-erased iterator while it is in use.
+template<typename T>
+struct ContainerAPI : CapabilitiesImpl<T>
+{
+    /**
+      Whether size() is expected to be constant-time for the container.
+     */
+    enum { HasCheapSize = SizeImpl<T>::HasCheapSize };
 
-  The function pointers for iterator operations have type-erased API - they
-  have parameters and return types which are void pointers or basic types.
-  Although the API of the functions are type-erased, particular typed
-  implementations of these operations are generated in the contructor of
-  SequentialIterableImplementation ([Disclosure 3]).
+    /**
+      Determine the size using the ``size()`` member of the container if it
+      has one, and otherwise by counting the elements.  The ContainerAPI
+      template may be specialized for particular containers which may
+      implement a more-efficient way to determine the size.
+    */
+    static int size(const T *t) { return SizeImpl<T>::size(t); }
+};
 
-  This class implements [Disclosure 2].
-  The methods in this class implement [Disclosure 4].
+/**
+  @brief Detection of element types which are themselves containers.
+
+  Types with a ``const_iterator`` and a ``value_type``, and C arrays, are
+  containers which FlatteningIterator descends into.  Strings are iterable
+  too, but are treated as leaves, as their characters are not elements of
+  the structure.
+ */
+template<typename T>
+struct IsNestedContainer
+{
+    template<typename U>
+    static char test(typename U::const_iterator *, typename U::value_type *);
+    template<typename U>
+    static long test(...);
+
+    enum { value = sizeof(test<T>(0, 0)) == sizeof(char) };
+};
+
+template<typename T, std::size_t N>
+struct IsNestedContainer<T[N]>
+{
+    enum { value = true };
+};
+
+template<typename C, typename Traits, typename Allocator>
+struct IsNestedContainer<std::basic_string<C, Traits, Allocator> >
+{
+    enum { value = false };
+};
+
+/**
+  @brief Destination of serialized containers.
+
+  Implementations may write to a buffer, a file, a socket etc.
+ */
+struct Writer
+{
+    virtual ~Writer() {}
+    virtual void write(const void *data, std::size_t size) = 0;
+};
+
+/**
+  @brief Header preceding the elements of a serialized container.
+
+  The elements follow the header directly, without padding, as ``count``
+  values of ``elementSize`` bytes.  ``byteCount`` is the size of the
+  elements in bytes, so that a reader can skip them without interpreting
+  the header further.
+ */
+struct SerializationHeader
+{
+    std::uint64_t byteCount;
+    std::uint64_t elementType;
+    std::uint64_t count;
+    std::uint64_t elementSize;
+};
+
+/**
+  Returns an identifier of the type ``T`` which, unlike metaTypeId(), is the
+  same in different processes.  It is a hash of the name of the type given
+  by ``typeid``, so it is only stable between programs built with the same
+  compiler ABI.
+ */
+template<typename T>
+std::uint64_t wireTypeId()
+{
+    static const std::uint64_t id = [] {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const char *c = typeid(T).name(); *c; ++c)
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        return hash;
+    }();
+    return id;
+}
+
+/**
+  Whether elements of type ``T`` may be serialized by copying their bytes.
+  Only arithmetic and enumeration types may be by default: trivially
+  copyable types may still hold pointers, such as ``const char*`` or the
+  reference held by a Variant, which would not be meaningful when read
+  back.  The template may be specialized to opt in plain structures of
+  values.
+ */
+template<typename T>
+struct IsSerializable
+  : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value>
+{
+};
+
+/**
+  @brief Serialization of the elements of a container into a Writer.
+
+  Only containers of elements for which IsSerializable holds may be
+  serialized.  Their elements are written in a single block if they are
+  contiguous, and otherwise through a fixed-size staging buffer so that the
+  Writer is called once per buffer rather than once per element.
+ */
+template<typename T,
+         bool Serializable = IsSerializable<typename ContainerTraits<T>::value_type>::value,
+         bool Contiguous = ContiguousStorage<T>::IsContiguous>
+struct SerializeImpl
+{
+    static bool serialize(const T *, Writer &) { return false; }
+};
+
+template<typename T, bool Contiguous>
+struct SerializeImpl<T, true, Contiguous>
+{
+    typedef typename ContainerTraits<T>::value_type value_type;
+
+    static_assert(std::is_trivially_copyable<value_type>::value,
+                  "IsSerializable may only be specialized for trivially copyable types");
+
+    enum { StagingSize = 4096 };
+
+    static void writeHeader(std::uint64_t count, Writer &writer)
+    {
+        const SerializationHeader header = {
+            count * sizeof(value_type),
+            wireTypeId<value_type>(),
+            count,
+            sizeof(value_type)
+        };
+        writer.write(&header, sizeof(header));
+    }
+
+    static bool serialize(const T *t, Writer &writer)
+    {
+        const std::size_t count = ContainerAPI<T>::size(t);
+        writeHeader(count, writer);
+        if (Contiguous) {
+            if (count)
+                writer.write(ContiguousStorage<T>::data(t), count * sizeof(value_type));
+            return true;
+        }
+
+        unsigned char staging[StagingSize];
+        std::size_t used = 0;
+        typename ContainerTraits<T>::const_iterator it = ContainerTraits<T>::begin(t);
+        const typename ContainerTraits<T>::const_iterator end = ContainerTraits<T>::end(t);
+        for ( ; it != end; ++it) {
+            if (sizeof(value_type) > StagingSize) {
+                writer.write(&*it, sizeof(value_type));
+                continue;
+            }
+            if (used + sizeof(value_type) > StagingSize) {
+                writer.write(staging, used);
+                used = 0;
+            }
+            std::memcpy(staging + used, &*it, sizeof(value_type));
+            used += sizeof(value_type);
+        }
+        if (used)
+            writer.write(staging, used);
+        return true;
+    }
+};
+
+/**
+  @brief Structure of reference to a container data and operations to perform on it.
+
+  Store a type-erased immutable reference to the container, the runtime-id of the type of
+  the elements in the container, a pointer to the per-type table holding the
+  capabilities (so that usable API may be determined at runtime) and the
+  function pointers for relevant operations, and a mutable location to store
+  a type-erased iterator while it is in use.
+
+  The function pointers for iterator operations have type-erased API - they
+  have parameters and return types which are void pointers or basic types.
+  Although the API of the functions are type-erased, particular typed
+  implementations of these operations are generated in the contructor of
+  SequentialIterableImplementation ([Disclosure 3]).
+
+  This class implements [Disclosure 2].
+  The methods in this class implement [Disclosure 4].
  */
 class SequentialIterableImplementation
 {
 public:
-    const void * _iterable;
-    void *_iterator;
-    std::size_t _metaType_id;
-    unsigned _iteratorCapabilities;
-    typedef int(*sizeFunc)(const void *p);
-    typedef const void * (*atFunc)(const void *p, int);
-    typedef void (*moveIteratorFunc)(const void *p, void **);
-    typedef void (*advanceFunc)(void **p, int);
-    typedef VariantData (*getFunc)( void * const *p, std::size_t metaTypeId);
-    typedef void (*destroyIterFunc)(void **p);
-    typedef bool (*equalIterFunc)(void * const *p, void * const *other);
-    typedef void (*copyIterFunc)(void **, void * const *);
-
-    sizeFunc _size;
-    atFunc _at;
-    moveIteratorFunc _moveToBegin;
-    moveIteratorFunc _moveToEnd;
-    advanceFunc _advance;
-    getFunc _get;
-    destroyIterFunc _destroyIter;
-    equalIterFunc _equalIter;
-    copyIterFunc _copyIter;
+    typedef int(*sizeFunc)(const void *p);
+    typedef const void * (*atFunc)(const void *p, int);
+    typedef void (*moveIteratorFunc)(const void *p, IteratorStorage *, IteratorArena *arena);
+    typedef void (*advanceFunc)(IteratorStorage *p, int);
+    typedef VariantData (*getFunc)(const IteratorStorage *p);
+    typedef void (*destroyIterFunc)(IteratorStorage *p);
+    typedef bool (*equalIterFunc)(const IteratorStorage *p, const IteratorStorage *other);
+    typedef void (*copyIterFunc)(IteratorStorage *, const IteratorStorage *);
+    typedef void (*relocateIterFunc)(IteratorStorage *, IteratorStorage *);
+    typedef const void * (*dataFunc)(const void *p);
+    typedef int (*getRangeFunc)(const void *p, int first, int count, const void **out);
+    typedef int (*fetchFunc)(IteratorStorage *p, const IteratorStorage *end, int count, const void **out);
+    typedef bool (*serializeFunc)(const void *p, Writer &writer);
+    typedef VariantData (*peekFunc)(const IteratorStorage *p, int offset);
+    typedef int (*advanceBoundedFunc)(IteratorStorage *p, const IteratorStorage *end, int step);
+    typedef void (*rawBatchFunc)(void *context, const void *const *elements, int count);
+    typedef int (*forEachRawFunc)(const void *p, rawBatchFunc callback, void *context, const void **batch, int batchSize);
+#ifdef TYPEERASURE_INSTRUMENTATION
+    typedef const char *(*typeNameFunc)();
+#endif
+
+    /**
+      @brief Table of the typed operations for one container type.
+
+      There is a single constant instance of the table per container type (see
+      OperationsFor), so each SequentialIterableImplementation refers to it
+      through one pointer instead of carrying a copy of every function pointer.
+     */
+    struct Operations
+    {
+        MetaTypeId _metaType_id;
+        unsigned _iteratorCapabilities;
+        std::size_t _elementSize;
+        bool _hasCheapSize;
+        sizeFunc _size;
+        atFunc _at;
+        moveIteratorFunc _moveToBegin;
+        moveIteratorFunc _moveToEnd;
+        advanceFunc _advance;
+        getFunc _get;
+        destroyIterFunc _destroyIter;
+        equalIterFunc _equalIter;
+        copyIterFunc _copyIter;
+        relocateIterFunc _relocateIter;
+        dataFunc _data;
+        getRangeFunc _getRange;
+        fetchFunc _fetch;
+        serializeFunc _serialize;
+        peekFunc _peek;
+        advanceBoundedFunc _advanceBounded;
+        forEachRawFunc _forEachRaw;
+        bool _isNestedContainer;
+        const Operations *_elementOps;
+#ifdef TYPEERASURE_INSTRUMENTATION
+        typeNameFunc _typeName;
+        TypeInstrumentationCounters *_counters;
+#endif
+    };
+
+    const void * _iterable;
+    IteratorStorage _iterator;
+    const Operations *_ops;
+
+    template<class T>
+    static int sizeImpl(const void *p)
+    { return ContainerAPI<T>::size(static_cast<const T*>(p)); }
+
+    template<class T>
+    static const void* atImpl(const void *p, int idx)
+    {
+        TYPEERASURE_COUNT(atCalls, 1);
+        TYPEERASURE_COUNT(atAdvanceDistance, idx);
+        typename ContainerTraits<T>::const_iterator i = ContainerTraits<T>::begin(static_cast<const T*>(p));
+        std::advance(i, idx);
+        return IteratorAPI<typename ContainerTraits<T>::const_iterator>::getData(i);
+    }
+
+    template<class T>
+    static void advanceImpl(IteratorStorage *p, int step)
+    {
+        TYPEERASURE_COUNT_TYPE(T, steps, step < 0 ? -step : step);
+        IteratorAPI<typename ContainerTraits<T>::const_iterator>::advance(p, step);
+    }
+
+    template<class T>
+    static void moveToBeginImpl(const void *container, IteratorStorage *iterator, IteratorArena *arena)
+    {
+        TYPEERASURE_COUNT_TYPE(T, iterations, 1);
+        IteratorAPI<typename ContainerTraits<T>::const_iterator>::assign(iterator, ContainerTraits<T>::begin(static_cast<const T*>(container)), arena);
+    }
+
+    template<class T>
+    static void moveToEndImpl(const void *container, IteratorStorage *iterator, IteratorArena *arena)
+    { IteratorAPI<typename ContainerTraits<T>::const_iterator>::assign(iterator, ContainerTraits<T>::end(static_cast<const T*>(container)), arena); }
+
+    template<class T>
+    static void destroyIterImpl(IteratorStorage *iterator)
+    { IteratorAPI<typename ContainerTraits<T>::const_iterator>::destroy(iterator); }
+
+    template<class T>
+    static bool equalIterImpl(const IteratorStorage *iterator, const IteratorStorage *other)
+    { return IteratorAPI<typename ContainerTraits<T>::const_iterator>::equal(iterator, other); }
+
+    template<class T>
+    static VariantData getImpl(const IteratorStorage *iterator)
+    { return VariantData(TypeErasure::metaTypeId<typename ContainerTraits<T>::value_type>(), IteratorAPI<typename ContainerTraits<T>::const_iterator>::getData(iterator)); }
+
+    template<class T>
+    static void copyIterImpl(IteratorStorage *dest, const IteratorStorage *src)
+    { IteratorAPI<typename ContainerTraits<T>::const_iterator>::assign(dest, src); }
+
+    template<class T>
+    static void relocateIterImpl(IteratorStorage *dest, IteratorStorage *src)
+    { IteratorAPI<typename ContainerTraits<T>::const_iterator>::relocate(dest, src); }
+
+    template<class T>
+    static const void *dataImpl(const void *p)
+    { return ContiguousStorage<T>::data(static_cast<const T*>(p)); }
+
+    template<class T>
+    static int getRangeImpl(const void *p, int first, int count, const void **out)
+    {
+        typedef ContainerTraits<T> Traits;
+        const T *container = static_cast<const T*>(p);
+        typename Traits::const_iterator it = Traits::begin(container);
+        const typename Traits::const_iterator end = Traits::end(container);
+        std::advance(it, first);
+        int fetched = 0;
+        for ( ; fetched < count && it != end; ++fetched, ++it)
+            out[fetched] = IteratorAPI<typename Traits::const_iterator>::getData(it);
+        return fetched;
+    }
+
+    template<class T>
+    static int fetchImpl(IteratorStorage *iterator, const IteratorStorage *end, int count, const void **out)
+    {
+        typedef IteratorAPI<typename ContainerTraits<T>::const_iterator> API;
+        int fetched = 0;
+        for ( ; fetched < count && !API::equal(iterator, end); ++fetched) {
+            out[fetched] = API::getData(iterator);
+            API::advance(iterator, 1);
+        }
+        TYPEERASURE_COUNT_TYPE(T, steps, fetched);
+        return fetched;
+    }
+
+    template<class T>
+    static bool serializeImpl(const void *p, Writer &writer)
+    { return SerializeImpl<T>::serialize(static_cast<const T*>(p), writer); }
+
+    template<class T>
+    static VariantData peekImpl(const IteratorStorage *iterator, int offset)
+    {
+        typedef IteratorAPI<typename ContainerTraits<T>::const_iterator> API;
+        typename ContainerTraits<T>::const_iterator it = API::get(iterator);
+        std::advance(it, offset);
+        return VariantData(TypeErasure::metaTypeId<typename ContainerTraits<T>::value_type>(), API::getData(it));
+    }
+
+    template<class T>
+    static int advanceBoundedImpl(IteratorStorage *iterator, const IteratorStorage *end, int step)
+    {
+        const int advanced = IteratorAPI<typename ContainerTraits<T>::const_iterator>::advanceBounded(iterator, end, step);
+        TYPEERASURE_COUNT_TYPE(T, steps, advanced);
+        return advanced;
+    }
+
+    /**
+      Collects element addresses into the caller's buffer and passes the
+      buffer to the callback each time it is full.
+     */
+    struct RawBatch
+    {
+        rawBatchFunc callback;
+        void *context;
+        const void **elements;
+        int capacity;
+        int count;
+
+        void operator()(const void *element)
+        {
+            elements[count++] = element;
+            if (count == capacity)
+                flush();
+        }
+
+        void flush()
+        {
+            if (count)
+                callback(context, elements, count);
+            count = 0;
+        }
+    };
+
+    template<class T>
+    static int forEachRawImpl(const void *p, rawBatchFunc callback, void *context, const void **batch, int batchSize)
+    {
+        typedef ContainerTraits<T> Traits;
+        const T *container = static_cast<const T*>(p);
+        RawBatch raw = { callback, context, batch, batchSize, 0 };
+        const int count = forEachPrefetching<IteratorAPI<typename Traits::const_iterator> >(Traits::begin(container), Traits::end(container), raw);
+        raw.flush();
+        TYPEERASURE_COUNT_TYPE(T, iterations, 1);
+        TYPEERASURE_COUNT_TYPE(T, steps, count);
+        return count;
+    }
+
+#ifdef TYPEERASURE_INSTRUMENTATION
+    template<class T>
+    static const char *typeNameImpl()
+    { return typeid(T).name(); }
+#endif
+
+    template<class T>
+    struct OperationsFor;
+
+    /**
+      The table of operations of the elements of ``T`` if they are nested
+      containers (see IsNestedContainer), and null otherwise.  This is
+      resolved at compile time, so that it does not depend on which types
+      have been registered.
+     */
+    template<class T, bool = IsNestedContainer<typename ContainerTraits<T>::value_type>::value>
+    struct ElementOperations
+    {
+        static constexpr const Operations *get() { return 0; }
+    };
+
+    template<class T>
+    struct ElementOperations<T, true>
+    {
+        static constexpr const Operations *get() { return &OperationsFor<typename ContainerTraits<T>::value_type>::table; }
+    };
+
+    template<class T>
+    struct OperationsFor
+    {
+#ifdef TYPEERASURE_INSTRUMENTATION
+        static TypeInstrumentationCounters counters;
+#endif
+        static constexpr Operations table = {
+            TypeErasure::metaTypeId<typename ContainerTraits<T>::value_type>(),
+            ContainerAPI<T>::IteratorCapabilities,
+            sizeof(typename ContainerTraits<T>::value_type),
+            ContainerAPI<T>::HasCheapSize,
+            sizeImpl<T>,
+            atImpl<T>,
+            moveToBeginImpl<T>,
+            moveToEndImpl<T>,
+            advanceImpl<T>,
+            getImpl<T>,
+            destroyIterImpl<T>,
+            equalIterImpl<T>,
+            copyIterImpl<T>,
+            IteratorAPI<typename ContainerTraits<T>::const_iterator>::BitwiseRelocatable ? 0 : relocateIterImpl<T>,
+            dataImpl<T>,
+            getRangeImpl<T>,
+            fetchImpl<T>,
+            serializeImpl<T>,
+            peekImpl<T>,
+            advanceBoundedImpl<T>,
+            forEachRawImpl<T>,
+            IsNestedContainer<T>::value,
+            ElementOperations<T>::get()
+#ifdef TYPEERASURE_INSTRUMENTATION
+            , typeNameImpl<T>
+            , &counters
+#endif
+        };
+    };
+
+public:
+    /**
+      @brief Constructor taking a pointer to a strongly-typed container.
+
+      Although the reference to the strongly-typed container is stored as a
+      type-erased void pointer, the strong type is necessary here in order
+      to select the table of typed function pointers (with type-erased API)
+      for each relevant operation.
+
+      This method implements [Disclosure 3].
+      The actual implementations of the created functions relate to
+      [Disclosure 5].
+     */
+    template<class T> SequentialIterableImplementation(const T*p)
+      : _iterable(p)
+      , _iterator()
+      , _ops(operationsFor<T>())
+    {
+    }
+
+    /**
+      @brief Constructor taking a type-erased container and the table of
+      operations for its type, as obtained from operationsFor().
+     */
+    SequentialIterableImplementation(const void *iterable, const Operations *ops)
+      : _iterable(iterable)
+      , _iterator()
+      , _ops(ops)
+    {
+    }
+
+    /**
+      @brief Default constructor
+
+      Initialize all data to null.
+     */
+    SequentialIterableImplementation()
+      : _iterable(0)
+      , _iterator()
+      , _ops(0)
+    {
+    }
+
+    template<class T>
+    static const Operations *operationsFor() { return &OperationsFor<T>::table; }
+
+    MetaTypeId metaTypeId() const { return _ops ? _ops->_metaType_id : TypeErasure::metaTypeId<void>(); }
+    unsigned iteratorCapabilities() const { return _ops ? _ops->_iteratorCapabilities : 0; }
+
+    inline void moveToBegin(IteratorArena *arena = 0) { _ops->_moveToBegin(_iterable, &_iterator, arena); }
+    inline void moveToEnd(IteratorArena *arena = 0) { _ops->_moveToEnd(_iterable, &_iterator, arena); }
+    inline bool equal(const SequentialIterableImplementation &other) const { return _ops->_equalIter(&_iterator, &other._iterator); }
+    inline SequentialIterableImplementation &advance(int i) {
+      assert(i > 0 || _ops->_iteratorCapabilities & BiDirectionalCapability);
+      _ops->_advance(&_iterator, i);
+      return *this;
+    }
+
+    inline VariantData getCurrent() const {
+      return _ops->_get(&_iterator);
+    }
+
+    VariantData at(int idx) const
+    { return VariantData(_ops->_metaType_id, _ops->_at(_iterable, idx)); }
+
+    int size() const { assert(_iterable); return _ops->_size(_iterable); }
+    bool hasCheapSize() const { return _ops && _ops->_hasCheapSize; }
+
+    const void *data() const
+    {
+      assert(_iterable && _ops->_iteratorCapabilities & ContiguousCapability);
+      return _ops->_data(_iterable);
+    }
+
+    std::size_t elementSize() const { return _ops->_elementSize; }
+
+    int getRange(int first, int count, const void **out) const
+    {
+      assert(_iterable && first >= 0 && count >= 0);
+      return _ops->_getRange(_iterable, first, count, out);
+    }
+
+    /**
+      Store the addresses of up to ``count`` elements from the current
+      iterator position in ``out``, stopping at ``end``.  The iterator is
+      advanced past the fetched elements.
+     */
+    int fetch(const SequentialIterableImplementation &end, int count, const void **out)
+    {
+      return _ops->_fetch(&_iterator, &end._iterator, count, out);
+    }
+
+    bool serialize(Writer &writer) const
+    {
+      assert(_iterable);
+      return _ops->_serialize(_iterable, writer);
+    }
+
+    /**
+      Returns the element ``offset`` elements from the current iterator
+      position, without moving the iterator.
+     */
+    VariantData peek(int offset) const
+    {
+      assert(offset >= 0 || _ops->_iteratorCapabilities & BiDirectionalCapability);
+      return _ops->_peek(&_iterator, offset);
+    }
+
+    /**
+      Advance the iterator by up to ``step`` elements, stopping at ``end``.
+      Returns the number of elements advanced.
+     */
+    int advanceBounded(const SequentialIterableImplementation &end, int step)
+    {
+      assert(step >= 0);
+      return _ops->_advanceBounded(&_iterator, &end._iterator, step);
+    }
+
+    /**
+      Pass the addresses of all elements to ``callback`` in batches of up to
+      ``batchSize``, using ``batch`` as the buffer, in a single typed
+      traversal of the container.  Returns the number of elements.
+     */
+    int forEachRaw(rawBatchFunc callback, void *context, const void **batch, int batchSize) const
+    {
+      assert(_iterable && batchSize > 0);
+      return _ops->_forEachRaw(_iterable, callback, context, batch, batchSize);
+    }
+
+    /**
+      @brief Copy constructor
+
+      The iterator, if any, is copied with the typed copy operation, so that
+      each instance owns its iterator.
+     */
+    SequentialIterableImplementation(const SequentialIterableImplementation &other)
+      : _iterable(other._iterable)
+      , _iterator()
+      , _ops(other._ops)
+    {
+      TYPEERASURE_COUNT(iteratorCopies, 1);
+      if (_ops)
+        _ops->_copyIter(&_iterator, &other._iterator);
+    }
+
+    /**
+      @brief Move constructor
+
+      The iterator is transferred to the new instance, and ``other`` is left
+      without an iterator.
+     */
+    SequentialIterableImplementation(SequentialIterableImplementation &&other) noexcept
+      : _iterable(other._iterable)
+      , _iterator()
+      , _ops(other._ops)
+    {
+      relocateIter(other);
+    }
+
+    SequentialIterableImplementation &operator=(const SequentialIterableImplementation &other)
+    {
+      if (this != &other) {
+        TYPEERASURE_COUNT(iteratorCopies, 1);
+        destroyIter();
+        _iterable = other._iterable;
+        _ops = other._ops;
+        if (_ops)
+          _ops->_copyIter(&_iterator, &other._iterator);
+      }
+      return *this;
+    }
+
+    SequentialIterableImplementation &operator=(SequentialIterableImplementation &&other) noexcept
+    {
+      if (this != &other) {
+        destroyIter();
+        _iterable = other._iterable;
+        _ops = other._ops;
+        relocateIter(other);
+      }
+      return *this;
+    }
+
+    ~SequentialIterableImplementation() { destroyIter(); }
+
+private:
+    void destroyIter()
+    {
+      if (_ops)
+        _ops->_destroyIter(&_iterator);
+      _iterator = IteratorStorage();
+    }
+
+    /**
+      Take over the iterator of ``other``, which has the same operations.
+      The storage is copied byte for byte unless the iterator is stored
+      inline and is not trivially copyable, in which case it is relocated
+      with the typed operation.
+     */
+    void relocateIter(SequentialIterableImplementation &other)
+    {
+      if (_ops && _ops->_relocateIter)
+        _ops->_relocateIter(&_iterator, &other._iterator);
+      else
+        _iterator = other._iterator;
+      other._iterator = IteratorStorage();
+    }
+};
+
+template<class T>
+constexpr SequentialIterableImplementation::Operations SequentialIterableImplementation::OperationsFor<T>::table;
+
+#ifdef TYPEERASURE_INSTRUMENTATION
+template<class T>
+TypeInstrumentationCounters SequentialIterableImplementation::OperationsFor<T>::counters;
+#endif
+
+/**
+  @brief Detection of associative containers.
+
+  Containers with ``key_type`` and ``mapped_type``, such as ``std::map`` and
+  ``std::unordered_map``, are associative.  Their elements are key/value
+  pairs, and they provide a native ``find`` for a key.
+ */
+template<typename T>
+struct IsAssociative
+{
+    template<typename U>
+    static char test(typename U::key_type *, typename U::mapped_type *);
+    template<typename U>
+    static long test(...);
+
+    enum { value = sizeof(test<T>(0, 0)) == sizeof(char) };
+};
+
+/**
+  @brief Structure of reference to an associative container and operations
+  to perform on it.
+
+  This mirrors SequentialIterableImplementation for associative containers.
+  Store a type-erased immutable reference to the container, the runtime-ids
+  of the key and value types, a pointer to the per-type table of operations
+  and a mutable location to store a type-erased iterator while it is in use.
+
+  Besides iteration, the operations include a type-erased lookup of a key,
+  which uses the ``find`` of the container, so that lookup has the complexity
+  of the container rather than of a linear scan.
+ */
+class AssociativeIterableImplementation
+{
+public:
+    typedef int(*sizeFunc)(const void *p);
+    typedef void (*moveIteratorFunc)(const void *p, IteratorStorage *);
+    typedef void (*findFunc)(const void *p, const void *key, IteratorStorage *);
+    typedef void (*advanceFunc)(IteratorStorage *p, int);
+    typedef const void * (*getFunc)(const IteratorStorage *p);
+    typedef void (*destroyIterFunc)(IteratorStorage *p);
+    typedef bool (*equalIterFunc)(const IteratorStorage *p, const IteratorStorage *other);
+    typedef void (*copyIterFunc)(IteratorStorage *, const IteratorStorage *);
+    typedef void (*relocateIterFunc)(IteratorStorage *, IteratorStorage *);
+    typedef void (*rawBatchFunc)(void *context, const void *const *keys, const void *const *values, int count);
+    typedef int (*forEachRawFunc)(const void *p, rawBatchFunc callback, void *context, const void **keys, const void **values, int batchSize);
+
+    /**
+      @brief Table of the typed operations for one associative container type.
+     */
+    struct Operations
+    {
+        MetaTypeId _keyMetaType_id;
+        MetaTypeId _valueMetaType_id;
+        unsigned _iteratorCapabilities;
+        sizeFunc _size;
+        moveIteratorFunc _moveToBegin;
+        moveIteratorFunc _moveToEnd;
+        findFunc _find;
+        advanceFunc _advance;
+        getFunc _getKey;
+        getFunc _getValue;
+        destroyIterFunc _destroyIter;
+        equalIterFunc _equalIter;
+        copyIterFunc _copyIter;
+        relocateIterFunc _relocateIter;
+        forEachRawFunc _forEachRaw;
+    };
+
+    const void * _iterable;
+    IteratorStorage _iterator;
+    const Operations *_ops;
+
+    template<class T>
+    static int sizeImpl(const void *p)
+    { return ContainerAPI<T>::size(static_cast<const T*>(p)); }
+
+    template<class T>
+    static void moveToBeginImpl(const void *container, IteratorStorage *iterator)
+    { IteratorAPI<typename T::const_iterator>::assign(iterator, static_cast<const T*>(container)->begin()); }
+
+    template<class T>
+    static void moveToEndImpl(const void *container, IteratorStorage *iterator)
+    { IteratorAPI<typename T::const_iterator>::assign(iterator, static_cast<const T*>(container)->end()); }
+
+    template<class T>
+    static void findImpl(const void *container, const void *key, IteratorStorage *iterator)
+    {
+        IteratorAPI<typename T::const_iterator>::assign(iterator,
+            static_cast<const T*>(container)->find(*static_cast<const typename T::key_type*>(key)));
+    }
+
+    template<class T>
+    static void advanceImpl(IteratorStorage *p, int step)
+    { IteratorAPI<typename T::const_iterator>::advance(p, step); }
+
+    template<class T>
+    static const void *getKeyImpl(const IteratorStorage *iterator)
+    { return &static_cast<const typename T::value_type*>(IteratorAPI<typename T::const_iterator>::getData(iterator))->first; }
+
+    template<class T>
+    static const void *getValueImpl(const IteratorStorage *iterator)
+    { return &static_cast<const typename T::value_type*>(IteratorAPI<typename T::const_iterator>::getData(iterator))->second; }
+
+    template<class T>
+    static void destroyIterImpl(IteratorStorage *iterator)
+    { IteratorAPI<typename T::const_iterator>::destroy(iterator); }
+
+    template<class T>
+    static bool equalIterImpl(const IteratorStorage *iterator, const IteratorStorage *other)
+    { return IteratorAPI<typename T::const_iterator>::equal(iterator, other); }
+
+    template<class T>
+    static void copyIterImpl(IteratorStorage *dest, const IteratorStorage *src)
+    { IteratorAPI<typename T::const_iterator>::assign(dest, src); }
+
+    template<class T>
+    static void relocateIterImpl(IteratorStorage *dest, IteratorStorage *src)
+    { IteratorAPI<typename T::const_iterator>::relocate(dest, src); }
+
+    /**
+      Collects key and value addresses into the caller's buffers and passes
+      them to the callback each time they are full.
+     */
+    template<class T>
+    struct RawBatch
+    {
+        rawBatchFunc callback;
+        void *context;
+        const void **keys;
+        const void **values;
+        int capacity;
+        int count;
+
+        void operator()(const void *element)
+        {
+            const typename T::value_type *entry = static_cast<const typename T::value_type*>(element);
+            keys[count] = &entry->first;
+            values[count] = &entry->second;
+            if (++count == capacity)
+                flush();
+        }
+
+        void flush()
+        {
+            if (count)
+                callback(context, keys, values, count);
+            count = 0;
+        }
+    };
+
+    template<class T>
+    static int forEachRawImpl(const void *p, rawBatchFunc callback, void *context, const void **keys, const void **values, int batchSize)
+    {
+        const T *container = static_cast<const T*>(p);
+        RawBatch<T> raw = { callback, context, keys, values, batchSize, 0 };
+        const int count = forEachPrefetching<IteratorAPI<typename T::const_iterator> >(container->begin(), container->end(), raw);
+        raw.flush();
+        return count;
+    }
+
+    template<class T>
+    struct OperationsFor
+    {
+        static constexpr Operations table = {
+            metaTypeId<typename T::key_type>(),
+            metaTypeId<typename T::mapped_type>(),
+            ContainerAPI<T>::IteratorCapabilities,
+            sizeImpl<T>,
+            moveToBeginImpl<T>,
+            moveToEndImpl<T>,
+            findImpl<T>,
+            advanceImpl<T>,
+            getKeyImpl<T>,
+            getValueImpl<T>,
+            destroyIterImpl<T>,
+            equalIterImpl<T>,
+            copyIterImpl<T>,
+            IteratorAPI<typename T::const_iterator>::BitwiseRelocatable ? 0 : relocateIterImpl<T>,
+            forEachRawImpl<T>
+        };
+    };
+
+public:
+    /**
+      @brief Constructor taking a pointer to a strongly-typed associative
+      container.
+     */
+    template<class T> AssociativeIterableImplementation(const T*p)
+      : _iterable(p)
+      , _iterator()
+      , _ops(operationsFor<T>())
+    {
+    }
+
+    /**
+      @brief Constructor taking a type-erased associative container and the
+      table of operations for its type, as obtained from operationsFor().
+     */
+    AssociativeIterableImplementation(const void *iterable, const Operations *ops)
+      : _iterable(iterable)
+      , _iterator()
+      , _ops(ops)
+    {
+    }
+
+    /**
+      @brief Default constructor
+
+      Initialize all data to null.
+     */
+    AssociativeIterableImplementation()
+      : _iterable(0)
+      , _iterator()
+      , _ops(0)
+    {
+    }
+
+    template<class T>
+    static const Operations *operationsFor() { return &OperationsFor<T>::table; }
+
+    MetaTypeId keyMetaTypeId() const { return _ops ? _ops->_keyMetaType_id : metaTypeId<void>(); }
+    MetaTypeId valueMetaTypeId() const { return _ops ? _ops->_valueMetaType_id : metaTypeId<void>(); }
+
+    unsigned iteratorCapabilities() const { return _ops ? _ops->_iteratorCapabilities : 0; }
+
+    inline void moveToBegin() { _ops->_moveToBegin(_iterable, &_iterator); }
+    inline void moveToEnd() { _ops->_moveToEnd(_iterable, &_iterator); }
+    inline void find(const void *key) { _ops->_find(_iterable, key, &_iterator); }
+    inline bool equal(const AssociativeIterableImplementation &other) const { return _ops->_equalIter(&_iterator, &other._iterator); }
+    inline AssociativeIterableImplementation &advance(int i) {
+      assert(i > 0 || _ops->_iteratorCapabilities & BiDirectionalCapability);
+      _ops->_advance(&_iterator, i);
+      return *this;
+    }
+
+    inline VariantData getCurrentKey() const {
+      return VariantData(_ops->_keyMetaType_id, _ops->_getKey(&_iterator));
+    }
+
+    inline VariantData getCurrentValue() const {
+      return VariantData(_ops->_valueMetaType_id, _ops->_getValue(&_iterator));
+    }
+
+    int size() const { assert(_iterable); return _ops->_size(_iterable); }
+
+    /**
+      Pass the addresses of all keys and values to ``callback`` in batches of
+      up to ``batchSize``, in a single typed traversal of the container.
+      Returns the number of entries.
+     */
+    int forEachRaw(rawBatchFunc callback, void *context, const void **keys, const void **values, int batchSize) const
+    {
+      assert(_iterable && batchSize > 0);
+      return _ops->_forEachRaw(_iterable, callback, context, keys, values, batchSize);
+    }
+
+    /**
+      @brief Copy constructor
+
+      As for SequentialIterableImplementation, the iterator, if any, is
+      copied with the typed copy operation, so that each instance owns its
+      iterator.
+     */
+    AssociativeIterableImplementation(const AssociativeIterableImplementation &other)
+      : _iterable(other._iterable)
+      , _iterator()
+      , _ops(other._ops)
+    {
+      if (_ops)
+        _ops->_copyIter(&_iterator, &other._iterator);
+    }
+
+    /**
+      @brief Move constructor
+
+      The iterator is transferred to the new instance, and ``other`` is left
+      without an iterator.
+     */
+    AssociativeIterableImplementation(AssociativeIterableImplementation &&other) noexcept
+      : _iterable(other._iterable)
+      , _iterator()
+      , _ops(other._ops)
+    {
+      relocateIter(other);
+    }
+
+    AssociativeIterableImplementation &operator=(const AssociativeIterableImplementation &other)
+    {
+      if (this != &other) {
+        destroyIter();
+        _iterable = other._iterable;
+        _ops = other._ops;
+        if (_ops)
+          _ops->_copyIter(&_iterator, &other._iterator);
+      }
+      return *this;
+    }
+
+    AssociativeIterableImplementation &operator=(AssociativeIterableImplementation &&other) noexcept
+    {
+      if (this != &other) {
+        destroyIter();
+        _iterable = other._iterable;
+        _ops = other._ops;
+        relocateIter(other);
+      }
+      return *this;
+    }
+
+    ~AssociativeIterableImplementation() { destroyIter(); }
+
+private:
+    void destroyIter()
+    {
+      if (_ops)
+        _ops->_destroyIter(&_iterator);
+      _iterator = IteratorStorage();
+    }
+
+    /**
+      Take over the iterator of ``other``, as in
+      SequentialIterableImplementation::relocateIter().
+     */
+    void relocateIter(AssociativeIterableImplementation &other)
+    {
+      if (_ops && _ops->_relocateIter)
+        _ops->_relocateIter(&_iterator, &other._iterator);
+      else
+        _iterator = other._iterator;
+      other._iterator = IteratorStorage();
+    }
+};
+
+template<class T>
+constexpr AssociativeIterableImplementation::Operations AssociativeIterableImplementation::OperationsFor<T>::table;
+
+/**
+  @brief Registry of mappings from runtime type identifier to implementation
+  of type-erased operations.
+
+  The registry maps the id of a container type to the table of operations
+  for that type.  It is an open-addressing hash table which is built for
+  concurrent readers.  Lookups take no locks: they load the current table and typically
+  probe a single slot.  An entry is published by a release store of its key
+  after its value is written, and is never modified afterwards.
+
+  Registrations are serialized with a mutex which readers never take.  When
+  the table becomes half full, the registering thread copies the entries to
+  a table of twice the size and publishes it atomically.  Readers which are
+  still using the previous table see a consistent (if slightly older)
+  snapshot, so previous tables are kept until the registry is destroyed.
+
+  Registering an id which is already present does not modify the registry.
+ */
+template<typename Operations>
+class ConverterRegistry
+{
+public:
+    enum { InitialCapacity = 64 };
+
+    ConverterRegistry()
+      : m_table(new Table(InitialCapacity, 0))
+    {
+    }
+
+    ~ConverterRegistry()
+    {
+        Table *table = m_table.load(std::memory_order_relaxed);
+        while (table) {
+            Table *previous = table->previous;
+            delete table;
+            table = previous;
+        }
+    }
+
+    /**
+      Insert the table of operations ``ops`` for ``id``.  Returns false if
+      ``id`` was already registered.
+     */
+    bool insert(MetaTypeId id, const Operations *ops)
+    {
+        assert(id != 0);
+        TYPEERASURE_COUNT(registryInserts, 1);
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        Table *table = m_table.load(std::memory_order_relaxed);
+        if (table->lookup(id))
+            return false;
+        if (2 * (table->count + 1) > table->capacity) {
+            Table *grown = new Table(2 * table->capacity, table);
+            for (std::size_t i = 0; i < table->capacity; ++i) {
+                const Entry &entry = table->entries[i];
+                const MetaTypeId key = entry.key.load(std::memory_order_relaxed);
+                if (key)
+                    grown->add(key, entry.value);
+            }
+            m_table.store(grown, std::memory_order_release);
+            table = grown;
+        }
+        table->add(id, ops);
+        return true;
+    }
+
+    /**
+      Returns the table of operations registered for ``id``, or null if
+      there is none.
+     */
+    const Operations *find(MetaTypeId id) const
+    {
+        TYPEERASURE_COUNT(registryLookups, 1);
+        return m_table.load(std::memory_order_acquire)->lookup(id);
+    }
+
+    /**
+      Call ``f`` with the id and the table of operations of each registered
+      type.  Types registered concurrently may or may not be included.
+     */
+    template<typename F>
+    void forEach(F f) const
+    {
+        const Table *table = m_table.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < table->capacity; ++i) {
+            const Entry &entry = table->entries[i];
+            const MetaTypeId key = entry.key.load(std::memory_order_acquire);
+            if (key)
+                f(key, entry.value);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Entry() : key(0), value(0) {}
+
+        std::atomic<MetaTypeId> key;
+        const Operations *value;
+    };
+
+    struct Table
+    {
+        Table(std::size_t capacity_, Table *previous_)
+          : capacity(capacity_)
+          , count(0)
+          , previous(previous_)
+          , entries(new Entry[capacity_])
+        {
+        }
+
+        ~Table()
+        {
+            delete[] entries;
+        }
+
+        std::size_t slotFor(MetaTypeId id) const
+        {
+            // Fibonacci hashing spreads the addresses, which differ mostly in
+            // their middle bits.
+            const unsigned long long address = reinterpret_cast<std::uintptr_t>(id);
+            return static_cast<std::size_t>((address * 11400714819323198485ull >> 32) % capacity);
+        }
+
+        const Operations *lookup(MetaTypeId id) const
+        {
+            for (std::size_t slot = slotFor(id); ; slot = (slot + 1) % capacity) {
+                const Entry &entry = entries[slot];
+                const MetaTypeId key = entry.key.load(std::memory_order_acquire);
+                if (key == 0)
+                    return 0;
+                if (key == id)
+                    return entry.value;
+            }
+        }
+
+        void add(MetaTypeId id, const Operations *ops)
+        {
+            std::size_t slot = slotFor(id);
+            while (entries[slot].key.load(std::memory_order_relaxed))
+                slot = (slot + 1) % capacity;
+            entries[slot].value = ops;
+            entries[slot].key.store(id, std::memory_order_release);
+            ++count;
+        }
+
+        const std::size_t capacity;
+        std::size_t count;
+        Table * const previous;
+        Entry * const entries;
+    };
+
+    ConverterRegistry(const ConverterRegistry &);
+    ConverterRegistry &operator=(const ConverterRegistry &);
+
+    std::atomic<Table*> m_table;
+    std::mutex m_writeMutex;
+};
+
+/**
+  This container is populated with mappings from runtime type identifier to
+  implementation of type-erased operations [Disclosure 1].
+ */
+ConverterRegistry<SequentialIterableImplementation::Operations> converterRegistry;
+
+/**
+  This container is populated with mappings from runtime type identifier to
+  implementation of type-erased operations for associative containers.
+ */
+ConverterRegistry<AssociativeIterableImplementation::Operations> associativeConverterRegistry;
+
+#ifdef TYPEERASURE_INSTRUMENTATION
+
+/**
+  @brief Values of the instrumentation counters at one point in time.
+
+  The counters are read independently of each other, so a snapshot taken
+  while other threads use the type-erasure layer is not exactly consistent.
+ */
+struct InstrumentationSnapshot
+{
+    struct ContainerType
+    {
+        MetaTypeId id;
+        const char *name;
+        unsigned long long iterations;
+        unsigned long long steps;
+    };
+
+    unsigned long long registryInserts;
+    unsigned long long registryLookups;
+    unsigned long long heapIterators;
+    unsigned long long iteratorCopies;
+    unsigned long long atCalls;
+    unsigned long long atAdvanceDistance;
+
+    /**
+      The counters of each container type in the converterRegistry.  The
+      name is as given by ``typeid``, and may be mangled.
+     */
+    std::vector<ContainerType> containerTypes;
+};
+
+InstrumentationSnapshot instrumentationSnapshot()
+{
+    const InstrumentationCounters &c = instrumentationCounters;
+    InstrumentationSnapshot snapshot;
+    snapshot.registryInserts = c.registryInserts.load(std::memory_order_relaxed);
+    snapshot.registryLookups = c.registryLookups.load(std::memory_order_relaxed);
+    snapshot.heapIterators = c.heapIterators.load(std::memory_order_relaxed);
+    snapshot.iteratorCopies = c.iteratorCopies.load(std::memory_order_relaxed);
+    snapshot.atCalls = c.atCalls.load(std::memory_order_relaxed);
+    snapshot.atAdvanceDistance = c.atAdvanceDistance.load(std::memory_order_relaxed);
+
+    std::vector<InstrumentationSnapshot::ContainerType> &types = snapshot.containerTypes;
+    converterRegistry.forEach([&types](MetaTypeId id, const SequentialIterableImplementation::Operations *ops) {
+        const InstrumentationSnapshot::ContainerType type = {
+            id,
+            ops->_typeName(),
+            ops->_counters->iterations.load(std::memory_order_relaxed),
+            ops->_counters->steps.load(std::memory_order_relaxed)
+        };
+        types.push_back(type);
+    });
+    return snapshot;
+}
+
+#endif
+
+/**
+  Registration of associative containers in the
+  associativeConverterRegistry, which is a no-op for other containers.
+ */
+template<typename T, bool = IsAssociative<T>::value>
+struct AssociativeRegistration
+{
+    static void insert() {}
+};
+
+template<typename T>
+struct AssociativeRegistration<T, true>
+{
+    static void insert()
+    { associativeConverterRegistry.insert(metaTypeId<T>(), AssociativeIterableImplementation::operationsFor<T>()); }
+};
+
+struct Variant;
+class FlatteningIterator;
+
+/**
+  @brief User-facing API for using the type-erased container implementation.
+
+  This class implements [Disclosure 7].
+ */
+class SequentialIterable
+{
+    SequentialIterableImplementation m_impl;
+
+    // The cursor cache of at() for containers without random access: the
+    // position m_cursorIndex of the iterator of m_cursor, or -1.
+    mutable SequentialIterableImplementation m_cursor;
+    mutable int m_cursorIndex;
+    bool m_cursorCacheEnabled;
+    IteratorArena *m_arena;
+
+    // The element addresses stored by buildIndex(), shared between copies.
+    std::shared_ptr<const std::vector<const void*> > m_index;
+public:
+    struct const_iterator;
+    struct const_reverse_iterator;
+    class StrideView;
+
+    friend struct const_iterator;
+    friend class FlatteningIterator;
+
+    explicit SequentialIterable(SequentialIterableImplementation impl);
+
+    SequentialIterable(const SequentialIterable &other);
+    SequentialIterable(SequentialIterable &&other);
+    SequentialIterable &operator=(const SequentialIterable &other);
+    SequentialIterable &operator=(SequentialIterable &&other);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+
+    StrideView stride(int step) const;
+
+    int size() const;
+    bool hasCheapSize() const;
+
+    bool canReverseIterate() const;
+    bool canRandomAccess() const;
+
+    const Variant at(int idx) const;
+    const Variant operator[](int idx) const;
+
+    void setCursorCacheEnabled(bool enabled);
+    bool isCursorCacheEnabled() const;
+
+    void setIteratorArena(IteratorArena *arena);
+    IteratorArena *iteratorArena() const;
+
+    void buildIndex();
+    void clearIndex();
+    bool hasIndex() const;
+
+    MetaTypeId elementType() const;
+    int getRange(int first, int count, const void **out) const;
+
+    bool isContiguous() const;
+    const void *data() const;
+    std::size_t elementSize() const;
+
+    bool serialize(Writer &writer) const;
+
+    template<typename... Ts, typename F>
+    bool visit(F &&f) const;
+
+    template<typename... Ts, typename F>
+    int visitGrouped(F &&f) const;
+
+    enum { RawBatchSize = 256 };
+
+    template<typename F>
+    int forEachRaw(F &&callback, int batchSize = RawBatchSize) const;
+
+private:
+    enum { VisitBatchSize = 64, IndexBatchSize = 256 };
+
+    template<typename F>
+    static void rawBatch(void *context, const void *const *elements, int count);
+
+    // The addresses of the values of those elements of a container of
+    // Variants which hold values of the given type, in container order.
+    struct TypeGroup
+    {
+        MetaTypeId type;
+        std::vector<const void*> elements;
+    };
+
+    static void partitionByType(const SequentialIterable &iterable, std::vector<TypeGroup> &groups);
+
+    template<typename T, typename F>
+    static void visitGroupAs(const TypeGroup &group, F &f);
+
+    VariantData cursorAt(int idx) const;
+
+    template<typename T, typename F>
+    static void visitAs(const SequentialIterable &iterable, F &f);
+};
+
+/**
+  Returns the number of elements, which is the size of the index if one was
+  built with buildIndex().
+ */
+int SequentialIterable::size() const
+{
+    if (m_index)
+        return static_cast<int>(m_index->size());
+    return m_impl.size();
+}
+
+/**
+  Whether size() is constant-time, rather than counting the elements.  This
+  may be used to decide whether to pre-size output buffers.
+ */
+bool SequentialIterable::hasCheapSize() const
+{
+    return m_index || m_impl.hasCheapSize();
+}
+
+bool SequentialIterable::canReverseIterate() const
+{
+    return m_impl.iteratorCapabilities() & BiDirectionalCapability;
+}
+
+/**
+  Whether the elements may be accessed by index in constant time with at().
+ */
+bool SequentialIterable::canRandomAccess() const
+{
+    return m_impl.iteratorCapabilities() & RandomAccessCapability;
+}
+
+/**
+  Returns the runtime type id of the elements in the container.
+ */
+MetaTypeId SequentialIterable::elementType() const
+{
+    return m_impl.metaTypeId();
+}
+
+/**
+  Store in ``out`` the addresses of up to ``count`` elements, starting at the
+  index ``first``, which must not be greater than size().  Returns the number
+  of elements stored, which is less than ``count`` if the end of the
+  container is reached.
+
+  All elements are fetched in a single typed operation, rather than through
+  a type-erased advance and dereference for each element.  The addresses are
+  of elements of type elementType(); elements which are of type ``Variant``
+  are not unwrapped.
+ */
+int SequentialIterable::getRange(int first, int count, const void **out) const
+{
+    if (m_index) {
+        const int size = static_cast<int>(m_index->size());
+        assert(first >= 0 && first <= size);
+        count = std::min(count, size - first);
+        std::copy(m_index->begin() + first, m_index->begin() + first + count, out);
+        return count;
+    }
+    return m_impl.getRange(first, count, out);
+}
+
+/**
+  Whether the elements are stored contiguously in memory, so that they may be
+  accessed directly through data() instead of through iterators.
+ */
+bool SequentialIterable::isContiguous() const
+{
+    return m_impl.iteratorCapabilities() & ContiguousCapability;
+}
+
+/**
+  Returns the address of the first of size() elements, each elementSize()
+  bytes apart.  Only valid if isContiguous() is true.
+ */
+const void *SequentialIterable::data() const
+{
+    return m_impl.data();
+}
+
+std::size_t SequentialIterable::elementSize() const
+{
+    return m_impl.elementSize();
+}
+
+/**
+  Write a SerializationHeader followed by the elements to ``writer``.
+  Returns false, without writing anything, if the elements may not be
+  serialized (see IsSerializable).  The elements may be read back without copying with
+  readSerialized().
+ */
+bool SequentialIterable::serialize(Writer &writer) const
+{
+    return m_impl.serialize(writer);
+}
+
+
+/**
+  @brief User-facing API for using the type-erased associative container
+  implementation.
+
+  This mirrors SequentialIterable for associative containers.  Dereferencing
+  a const_iterator yields the value of the element, and the key is available
+  through const_iterator::key().
+ */
+class AssociativeIterable
+{
+    AssociativeIterableImplementation m_impl;
+public:
+    struct const_iterator;
+
+    friend struct const_iterator;
+
+    explicit AssociativeIterable(AssociativeIterableImplementation impl);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    const_iterator find(const VariantData &key) const;
+    template<typename K>
+    const_iterator find(const K &key) const;
+
+    int size() const;
+
+    MetaTypeId keyType() const;
+    MetaTypeId valueType() const;
+
+    enum { RawBatchSize = 256 };
+
+    template<typename F>
+    int forEachRaw(F &&callback, int batchSize = RawBatchSize) const;
+
+private:
+    template<typename F>
+    static void rawBatch(void *context, const void *const *keys, const void *const *values, int count);
+};
+
+AssociativeIterable::AssociativeIterable(AssociativeIterableImplementation impl)
+  : m_impl(std::move(impl))
+{
+}
+
+int AssociativeIterable::size() const
+{
+    return m_impl.size();
+}
+
+MetaTypeId AssociativeIterable::keyType() const
+{
+    return m_impl.keyMetaTypeId();
+}
+
+MetaTypeId AssociativeIterable::valueType() const
+{
+    return m_impl.valueMetaTypeId();
+}
+
+/**
+  @brief User-facing API for handling type-erased data which may be a container.
+
+  This class implements [Disclosure 1].
+ */
+struct Variant
+{
+  VariantData data;
+
+  /**
+    The table of operations of the container type, if the Variant was
+    constructed from a strongly-typed container.  This allows conversion to
+    SequentialIterable without a lookup in the converterRegistry.
+   */
+  const SequentialIterableImplementation::Operations *sequentialOps;
+
+  /**
+    @brief Contructor accepting a strongly-typed container.
+
+    Populate the converterRegistry ([Disclosure 1]). Forward the strong type
+    to SequentialIterableImplementation to implement [Disclosure 3].
+
+    The registration is performed only once for each type ``T``, so later
+    constructions only store the type id, the pointer and the table of
+    operations.
+   */
+  template<typename T>
+  Variant(const T& t)
+    : data(metaTypeId<T>(), &t)
+    , sequentialOps(SequentialIterableImplementation::operationsFor<T>())
+  {
+      static const bool registered = registerContainer<T>();
+      (void)registered;
+  }
+  Variant(const VariantData data_)
+    : data(data_)
+    , sequentialOps(0)
+  {
+  }
+
+  MetaTypeId type() const
+  {
+      return data.metaTypeId;
+  }
+
+  /**
+    Returns a copy of the data, which must be of type ``T``.  This is
+    available only for trivially copyable types, for which the copy is
+    cheap.  Use asRef() or get_if() to access other types without copying.
+   */
+  template<typename T>
+  T as() const
+  {
+      static_assert(std::is_trivially_copyable<T>::value,
+                    "Variant::as<T>() copies the data; use asRef<T>() or get_if<T>()");
+      return asRef<T>();
+  }
+
+  /**
+    Returns a reference to the data, which must be of type ``T``.
+   */
+  template<typename T>
+  const T &asRef() const
+  {
+      assert(data.metaTypeId == metaTypeId<T>());
+      return *static_cast<const T*>(data.data);
+  }
+
+  /**
+    Returns a pointer to the data if it is of type ``T``, and null otherwise.
+   */
+  template<typename T>
+  const T *get_if() const
+  {
+      return data.metaTypeId == metaTypeId<T>() ? static_cast<const T*>(data.data) : 0;
+  }
+
+private:
+  template<typename T>
+  static bool registerContainer()
+  {
+      converterRegistry.insert(metaTypeId<T>(), SequentialIterableImplementation::operationsFor<T>());
+      AssociativeRegistration<T>::insert();
+      return true;
+  }
+};
+
+/**
+  The SequentialIterable refers to the data of this Variant.  The table of
+  operations is looked up in the converterRegistry only if this Variant was
+  not constructed from a strongly-typed container.
+ */
+template<>
+SequentialIterable Variant::as<SequentialIterable>() const
+{
+    const SequentialIterableImplementation::Operations *ops = sequentialOps ? sequentialOps : converterRegistry.find(data.metaTypeId);
+    assert(ops);
+
+    return SequentialIterable{ SequentialIterableImplementation(data.data, ops) };
+}
+
+template<>
+AssociativeIterable Variant::as<AssociativeIterable>() const
+{
+    const AssociativeIterableImplementation::Operations *ops = associativeConverterRegistry.find(data.metaTypeId);
+    assert(ops);
+
+    return AssociativeIterable{ AssociativeIterableImplementation(data.data, ops) };
+}
+
+/**
+  Wrap the element ``d`` of a container in a ``Variant``.  Elements which are
+  themselves of type ``Variant`` are returned unchanged.
+
+  This implements [Disclosure 8]
+ */
+const Variant elementVariant(const VariantData &d)
+{
+    if (d.metaTypeId == metaTypeId<Variant>())
+        return *reinterpret_cast<const Variant*>(d.data);
+    Variant v = { d };
+    return v;
+}
+
+/**
+  Returns the element at index ``idx``.
+
+  Only containers with the RandomAccessCapability may be indexed, unless an
+  index was built with buildIndex() or the cursor cache is enabled, so that
+  indexing in a loop can not silently become quadratic.  Use the
+  const_iterator for other containers.  (If assertions are disabled, other
+  containers are walked from the beginning on each call, without using or
+  modifying the cursor cache.)
+ */
+const Variant SequentialIterable::at(int idx) const
+{
+    assert(idx >= 0);
+    if (m_index) {
+        assert(idx < static_cast<int>(m_index->size()));
+        return elementVariant(VariantData(elementType(), (*m_index)[idx]));
+    }
+    if (canRandomAccess())
+        return elementVariant(m_impl.at(idx));
+    assert(m_cursorCacheEnabled);
+    if (!m_cursorCacheEnabled)
+        return elementVariant(m_impl.at(idx));
+    return elementVariant(cursorAt(idx));
+}
+
+/**
+  Enable at() for containers without the RandomAccessCapability.  The
+  iterator to the element last accessed is then cached, and each access
+  moves it from wherever is nearest: the cached position, the beginning, or
+  the end if the container is bidirectional and has a cheap size.
+  Accessing nearby indexes in order is therefore amortized constant-time.
+
+  The cache is modified by at(), so the SequentialIterable must then not be
+  used from several threads at once, and the container must not be modified
+  while the cache is enabled.  Disabling the cache releases the iterator.
+ */
+void SequentialIterable::setCursorCacheEnabled(bool enabled)
+{
+    m_cursorCacheEnabled = enabled;
+    if (!enabled) {
+        m_cursor = SequentialIterableImplementation();
+        m_cursorIndex = -1;
+    }
+}
+
+bool SequentialIterable::isCursorCacheEnabled() const
+{
+    return m_cursorCacheEnabled;
+}
+
+/**
+  Allocate the iterators which can not be stored inline from ``arena``,
+  rather than from the global heap, or from the global heap if ``arena`` is
+  null.  This applies to the iterators created after the call, including
+  their copies, which must all be destroyed before the arena is reset.
+ */
+void SequentialIterable::setIteratorArena(IteratorArena *arena)
+{
+    m_arena = arena;
+}
+
+IteratorArena *SequentialIterable::iteratorArena() const
+{
+    return m_arena;
+}
+
+VariantData SequentialIterable::cursorAt(int idx) const
+{
+    const bool bidirectional = canReverseIterate();
+
+    enum { FromBegin, FromCursor, FromEnd } origin = FromBegin;
+    int distance = idx;
+    if (m_cursorIndex >= 0 && (idx >= m_cursorIndex || bidirectional)) {
+        const int fromCursor = idx >= m_cursorIndex ? idx - m_cursorIndex : m_cursorIndex - idx;
+        if (fromCursor <= distance) {
+            origin = FromCursor;
+            distance = fromCursor;
+        }
+    }
+    int size = 0;
+    if (bidirectional && hasCheapSize()) {
+        size = m_impl.size();
+        assert(idx < size);
+        if (size - idx < distance)
+            origin = FromEnd;
+    }
+
+    if (origin != FromCursor)
+        m_cursor = SequentialIterableImplementation(m_impl._iterable, m_impl._ops);
+    if (origin == FromBegin) {
+        m_cursor.moveToBegin(m_arena);
+        if (idx > 0)
+            m_cursor.advance(idx);
+    } else if (origin == FromEnd) {
+        m_cursor.moveToEnd(m_arena);
+        m_cursor.advance(idx - size);
+    } else if (idx != m_cursorIndex) {
+        m_cursor.advance(idx - m_cursorIndex);
+    }
+    m_cursorIndex = idx;
+    return m_cursor.getCurrent();
+}
+
+const Variant SequentialIterable::operator[](int idx) const
+{
+    return at(idx);
+}
+
+/**
+  @brief User-facing API for using the type-erased container implementation.
+
+  The implementation of these methods forward to the SequentialIterableImplementation.
+
+  This class implements [Disclosure 7]
+ */
+struct SequentialIterable::const_iterator
+{
+private:
+    SequentialIterableImplementation m_impl;
+    friend class SequentialIterable;
+    friend struct const_reverse_iterator;
+    friend class StrideView;
+    explicit const_iterator(const SequentialIterable &iter);
+
+    void begin(IteratorArena *arena);
+    void end(IteratorArena *arena);
+public:
+    // The SequentialIterableImplementation owns the iterator, so copying
+    // copies it and moving transfers it.
+    const_iterator(const const_iterator &other) = default;
+    const_iterator(const_iterator &&other) = default;
+
+    const_iterator& operator=(const const_iterator &other) = default;
+    const_iterator& operator=(const_iterator &&other) = default;
+
+    const Variant operator*() const;
+    bool operator==(const const_iterator &o) const;
+    bool operator!=(const const_iterator &o) const;
+    const_iterator &operator++();
+    const_iterator operator++(int);
+    const_iterator &operator--();
+    const_iterator operator--(int);
+    const_iterator &operator+=(int j);
+    const_iterator &operator-=(int j);
+    const_iterator operator+(int j) const;
+    const_iterator operator-(int j) const;
+};
+
+SequentialIterable::SequentialIterable(SequentialIterableImplementation impl)
+  : m_impl(std::move(impl))
+  , m_cursorIndex(-1)
+  , m_cursorCacheEnabled(false)
+  , m_arena(0)
+{
+}
+
+/**
+  A SequentialIterable does not hold an iterator other than its cursor
+  cache, which is not copied, so copying it only copies the references to
+  the container, its operations and its index.
+ */
+SequentialIterable::SequentialIterable(const SequentialIterable &other)
+  : m_impl(other.m_impl._iterable, other.m_impl._ops)
+  , m_cursorIndex(-1)
+  , m_cursorCacheEnabled(other.m_cursorCacheEnabled)
+  , m_arena(other.m_arena)
+  , m_index(other.m_index)
+{
+}
+
+SequentialIterable::SequentialIterable(SequentialIterable &&other)
+  : m_impl(std::move(other.m_impl))
+  , m_cursor(std::move(other.m_cursor))
+  , m_cursorIndex(other.m_cursorIndex)
+  , m_cursorCacheEnabled(other.m_cursorCacheEnabled)
+  , m_arena(other.m_arena)
+  , m_index(std::move(other.m_index))
+{
+    other.m_cursorIndex = -1;
+}
+
+SequentialIterable &SequentialIterable::operator=(const SequentialIterable &other)
+{
+    if (this != &other) {
+        m_impl = SequentialIterableImplementation(other.m_impl._iterable, other.m_impl._ops);
+        m_cursor = SequentialIterableImplementation();
+        m_cursorIndex = -1;
+        m_cursorCacheEnabled = other.m_cursorCacheEnabled;
+        m_arena = other.m_arena;
+        m_index = other.m_index;
+    }
+    return *this;
+}
+
+SequentialIterable &SequentialIterable::operator=(SequentialIterable &&other)
+{
+    if (this != &other) {
+        m_impl = std::move(other.m_impl);
+        m_cursor = std::move(other.m_cursor);
+        m_cursorIndex = other.m_cursorIndex;
+        m_cursorCacheEnabled = other.m_cursorCacheEnabled;
+        m_arena = other.m_arena;
+        m_index = std::move(other.m_index);
+        other.m_cursorIndex = -1;
+    }
+    return *this;
+}
+
+/**
+  Each const_iterator owns its iterator state.  This constructor takes the
+  container and operations from ``iter`` and does not yet hold an iterator;
+  one is assigned by begin() or end().
+ */
+SequentialIterable::const_iterator::const_iterator(const SequentialIterable &iter)
+  : m_impl(iter.m_impl._iterable, iter.m_impl._ops)
+{
+}
+
+void SequentialIterable::const_iterator::begin(IteratorArena *arena)
+{
+    m_impl.moveToBegin(arena);
+}
+
+void SequentialIterable::const_iterator::end(IteratorArena *arena)
+{
+    m_impl.moveToEnd(arena);
+}
+
+SequentialIterable::const_iterator SequentialIterable::begin() const
+{
+    const_iterator it(*this);
+    it.begin(m_arena);
+    return it;
+}
+
+SequentialIterable::const_iterator SequentialIterable::end() const
+{
+    const_iterator it(*this);
+    it.end(m_arena);
+    return it;
+}
+
+/**
+  Store the addresses of all elements in a flat array, in a single pass over
+  the container.  at(), getRange() and size() then read the array instead of
+  walking the container, so a container without the RandomAccessCapability
+  may be indexed in constant time and divided into chunks by
+  parallelForEach().
+
+  The index is a snapshot: like an iterator, it is invalidated by
+  modifications of the container, after which buildIndex() must be called
+  again or the index released with clearIndex().  Copies of the
+  SequentialIterable share the index.
+ */
+void SequentialIterable::buildIndex()
+{
+    std::shared_ptr<std::vector<const void*> > index = std::make_shared<std::vector<const void*> >();
+    if (m_impl.hasCheapSize())
+        index->reserve(m_impl.size());
+
+    const_iterator it = begin();
+    const const_iterator last = end();
+    int fetched;
+    do {
+        const std::size_t used = index->size();
+        index->resize(used + IndexBatchSize);
+        fetched = it.m_impl.fetch(last.m_impl, IndexBatchSize, index->data() + used);
+        index->resize(used + fetched);
+    } while (fetched > 0);
+    m_index = index;
+}
+
+void SequentialIterable::clearIndex()
+{
+    m_index.reset();
+}
+
+bool SequentialIterable::hasIndex() const
+{
+    return static_cast<bool>(m_index);
+}
+
+/**
+  Dereference operator implements [Disclosure 8]
+ */
+const Variant SequentialIterable::const_iterator::operator*() const
+{
+    return elementVariant(m_impl.getCurrent());
+}
+
+bool SequentialIterable::const_iterator::operator==(const const_iterator &other) const
+{
+    return m_impl.equal(other.m_impl);
+}
+
+bool SequentialIterable::const_iterator::operator!=(const const_iterator &other) const
+{
+    return !m_impl.equal(other.m_impl);
+}
+
+SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator++()
+{
+    m_impl.advance(1);
+    return *this;
+}
+
+SequentialIterable::const_iterator SequentialIterable::const_iterator::operator++(int)
+{
+    const_iterator result(*this);
+    m_impl.advance(1);
+    return result;
+}
+
+SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator--()
+{
+    m_impl.advance(-1);
+    return *this;
+}
+
+SequentialIterable::const_iterator SequentialIterable::const_iterator::operator--(int)
+{
+    const_iterator result(*this);
+    m_impl.advance(-1);
+    return result;
+}
+
+SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator+=(int j)
+{
+    m_impl.advance(j);
+    return *this;
+}
+
+SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator-=(int j)
+{
+    m_impl.advance(-j);
+    return *this;
+}
+
+SequentialIterable::const_iterator SequentialIterable::const_iterator::operator+(int j) const
+{
+    const_iterator result(*this);
+    result.m_impl.advance(j);
+    return result;
+}
+
+SequentialIterable::const_iterator SequentialIterable::const_iterator::operator-(int j) const
+{
+    const_iterator result(*this);
+    result.m_impl.advance(-j);
+    return result;
+}
+
+/**
+  @brief Iterator over the elements of a SequentialIterable in reverse.
+
+  As for ``std::reverse_iterator``, the element referred to is the one
+  before the position of the underlying const_iterator, so that rend() is
+  at the beginning of the container.  The element is accessed with a single
+  typed peek operation, and each increment is a single typed decrement.
+  Only containers which canReverseIterate() may be iterated in reverse.
+ */
+struct SequentialIterable::const_reverse_iterator
+{
+private:
+    const_iterator m_base;
+    friend class SequentialIterable;
+    explicit const_reverse_iterator(const_iterator base) : m_base(std::move(base)) {}
+
+public:
+    const Variant operator*() const { return elementVariant(m_base.m_impl.peek(-1)); }
+    bool operator==(const const_reverse_iterator &o) const { return m_base == o.m_base; }
+    bool operator!=(const const_reverse_iterator &o) const { return m_base != o.m_base; }
+    const_reverse_iterator &operator++() { --m_base; return *this; }
+    const_reverse_iterator &operator--() { ++m_base; return *this; }
 
-    template<class T>
-    static int sizeImpl(const void *p)
-    { return ContainerAPI<T>::size(static_cast<const T*>(p)); }
+    const_iterator base() const { return m_base; }
+};
 
-    template<class T>
-    static const void* atImpl(const void *p, int idx)
-    {
-        typename T::const_iterator i = static_cast<const T*>(p)->begin();
-        std::advance(i, idx);
-        return IteratorAPI<typename T::const_iterator>::getData(i);
-    }
+SequentialIterable::const_reverse_iterator SequentialIterable::rbegin() const
+{
+    assert(canReverseIterate());
+    return const_reverse_iterator(end());
+}
 
-    template<class T>
-    static void advanceImpl(void **p, int step)
-    { IteratorAPI<typename T::const_iterator>::advance(p, step); }
+SequentialIterable::const_reverse_iterator SequentialIterable::rend() const
+{
+    assert(canReverseIterate());
+    return const_reverse_iterator(begin());
+}
 
-    template<class T>
-    static void moveToBeginImpl(const void *container, void **iterator)
-    { IteratorAPI<typename T::const_iterator>::assign(iterator, static_cast<const T*>(container)->begin()); }
+/**
+  @brief View of every ``step``-th element of a SequentialIterable, starting
+  with the first.
 
-    template<class T>
-    static void moveToEndImpl(const void *container, void **iterator)
-    { IteratorAPI<typename T::const_iterator>::assign(iterator, static_cast<const T*>(container)->end()); }
+  Each increment is a single typed operation which advances by ``step``
+  elements, by addition for random-access containers, and stops at the end
+  of the container.  The view holds a copy of the SequentialIterable, so it
+  may outlive the one it was created from.
+ */
+class SequentialIterable::StrideView
+{
+public:
+    struct const_iterator
+    {
+    private:
+        SequentialIterable::const_iterator m_it;
+        SequentialIterable::const_iterator m_end;
+        int m_step;
+        friend class StrideView;
+
+        const_iterator(SequentialIterable::const_iterator it, const SequentialIterable::const_iterator &end, int step)
+          : m_it(std::move(it)), m_end(end), m_step(step) {}
+
+    public:
+        const Variant operator*() const { return *m_it; }
+        bool operator==(const const_iterator &o) const { return m_it == o.m_it; }
+        bool operator!=(const const_iterator &o) const { return m_it != o.m_it; }
+        const_iterator &operator++()
+        {
+            m_it.m_impl.advanceBounded(m_end.m_impl, m_step);
+            return *this;
+        }
+    };
+
+    const_iterator begin() const
+    {
+        const SequentialIterable::const_iterator end = m_iterable.end();
+        return const_iterator(m_iterable.begin(), end, m_step);
+    }
 
-    template<class T>
-    static void destroyIterImpl(void **iterator)
-    { IteratorAPI<typename T::const_iterator>::destroy(iterator); }
+    const_iterator end() const
+    {
+        const SequentialIterable::const_iterator end = m_iterable.end();
+        return const_iterator(end, end, m_step);
+    }
 
-    template<class T>
-    static bool equalIterImpl(void * const *iterator, void * const *other)
-    { return IteratorAPI<typename T::const_iterator>::equal(iterator, other); }
+    int step() const { return m_step; }
 
-    template<class T>
-    static VariantData getImpl(void * const *iterator, std::size_t metaTypeId)
-    { return VariantData(metaTypeId, IteratorAPI<typename T::const_iterator>::getData(iterator)); }
+private:
+    friend class SequentialIterable;
+    StrideView(const SequentialIterable &iterable, int step) : m_iterable(iterable), m_step(step) {}
 
-    template<class T>
-    static void copyIterImpl(void **dest, void * const * src)
-    { IteratorAPI<typename T::const_iterator>::assign(dest, src); }
+    SequentialIterable m_iterable;
+    int m_step;
+};
 
-public:
-    /**
-      @brief Constructor taking a pointer to a strongly-typed container.
+/**
+  Returns a view of every ``step``-th element, starting with the first.
+ */
+SequentialIterable::StrideView SequentialIterable::stride(int step) const
+{
+    assert(step > 0);
+    return StrideView(*this, step);
+}
 
-      Although the reference to the strongly-typed container is stored as a
-      type-erased void pointer, the strong type is necessary here in order
-      to create typed function pointers (with type-erased API) for each
-      relevant operation.
+/**
+  Call ``f`` with each element of ``iterable``, typed as ``T``.
 
-      This method implements [Disclosure 3].
-      The actual implementations of the created functions relate to
-      [Disclosure 5].
-     */
-    template<class T> SequentialIterableImplementation(const T*p)
-      : _iterable(p)
-      , _iterator(0)
-      , _metaType_id(typeid(typename T::value_type).hash_code())
-      , _iteratorCapabilities(ContainerAPI<T>::IteratorCapabilities)
-      , _size(sizeImpl<T>)
-      , _at(atImpl<T>)
-      , _moveToBegin(moveToBeginImpl<T>)
-      , _moveToEnd(moveToEndImpl<T>)
-      , _advance(advanceImpl<T>)
-      , _get(getImpl<T>)
-      , _destroyIter(destroyIterImpl<T>)
-      , _equalIter(equalIterImpl<T>)
-      , _copyIter(copyIterImpl<T>)
-    {
+  Contiguous containers are walked directly in memory.  The elements of other
+  containers are passed in batches by forEachRaw(), so that there is one
+  type-erased call per batch rather than per element.
+ */
+template<typename T, typename F>
+void SequentialIterable::visitAs(const SequentialIterable &iterable, F &f)
+{
+    if (iterable.isContiguous()) {
+        const T *it = static_cast<const T*>(iterable.data());
+        const T * const end = it + iterable.size();
+        for ( ; it != end; ++it)
+            f(*it);
+        return;
     }
 
-    /**
-      @brief Default constructor
+    struct TypedBatch
+    {
+        F &f;
+        void operator()(const void *const *elements, int count)
+        {
+            for (int i = 0; i < count; ++i)
+                f(*static_cast<const T*>(elements[i]));
+        }
+    } typedBatch = { f };
+    iterable.forEachRaw(typedBatch, VisitBatchSize);
+}
 
-      Initialize all data to null.
-     */
-    SequentialIterableImplementation()
-      : _iterable(0)
-      , _iterator(0)
-      , _metaType_id(typeid(void).hash_code())
-      , _iteratorCapabilities(0)
-      , _size(0)
-      , _at(0)
-      , _moveToBegin(0)
-      , _moveToEnd(0)
-      , _advance(0)
-      , _get(0)
-      , _destroyIter(0)
-      , _equalIter(0)
-      , _copyIter(0)
-    {
-    }
-
-    inline void moveToBegin() { _moveToBegin(_iterable, &_iterator); }
-    inline void moveToEnd() { _moveToEnd(_iterable, &_iterator); }
-    inline bool equal(const SequentialIterableImplementation &other) const { return _equalIter(&_iterator, &other._iterator); }
-    inline SequentialIterableImplementation &advance(int i) {
-      assert(i > 0 || _iteratorCapabilities & BiDirectionalCapability);
-      _advance(&_iterator, i);
-      return *this;
-    }
+template<typename F>
+void SequentialIterable::rawBatch(void *context, const void *const *elements, int count)
+{
+    (*static_cast<F*>(context))(elements, count);
+}
 
-    inline VariantData getCurrent() const {
-      return _get(&_iterator, _metaType_id);
+/**
+  Call ``callback(const void *const *elements, int count)`` with the
+  addresses of the elements of type elementType(), in order and in batches
+  of up to ``batchSize``, which is clamped to between 1 and RawBatchSize.
+  Returns the number of elements.
+
+  The container is walked by a single typed operation, which prefetches the
+  elements a few positions ahead (see forEachPrefetching()), so that there is
+  no type-erased call per element and the latency of node-based containers
+  is partly hidden.  If an index was built with buildIndex(), the batches
+  are taken directly from the index instead.
+ */
+template<typename F>
+int SequentialIterable::forEachRaw(F &&callback, int batchSize) const
+{
+    batchSize = std::max(1, std::min<int>(batchSize, RawBatchSize));
+    if (m_index) {
+        const int size = static_cast<int>(m_index->size());
+        for (int first = 0; first < size; first += batchSize)
+            callback(m_index->data() + first, std::min(batchSize, size - first));
+        return size;
     }
 
-    VariantData at(int idx) const
-    { return VariantData(_metaType_id, _at(_iterable, idx)); }
-
-    int size() const { assert(_iterable); return _size(_iterable); }
+    typedef typename std::remove_reference<F>::type Callback;
+    const void *batch[RawBatchSize];
+    return m_impl.forEachRaw(&SequentialIterable::rawBatch<Callback>,
+                             const_cast<void*>(static_cast<const void*>(&callback)), batch, batchSize);
+}
 
-    inline void destroyIter() { _destroyIter(&_iterator); }
+/**
+  Call ``f`` with each element of the container, typed as whichever of
+  ``Ts`` is the element type.  Returns false, without calling ``f``, if the
+  element type is none of ``Ts``.
 
-    void copy(const SequentialIterableImplementation &other)
-    {
-      *this = other;
-      _copyIter(&_iterator, &other._iterator);
+  The element type is determined once for the container by looking it up in
+  a table of the candidate types, rather than once for each element.
+ */
+template<typename... Ts, typename F>
+bool SequentialIterable::visit(F &&f) const
+{
+    static_assert(sizeof...(Ts) > 0, "At least one element type must be given");
+
+    typedef typename std::remove_reference<F>::type Visitor;
+    typedef void (*VisitFunc)(const SequentialIterable &, Visitor &);
+    static const VisitFunc visitors[] = { &SequentialIterable::visitAs<Ts, Visitor>... };
+    static const MetaTypeId types[] = { metaTypeId<Ts>()... };
+
+    const MetaTypeId type = elementType();
+    for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+        if (types[i] == type) {
+            visitors[i](*this, f);
+            return true;
+        }
     }
-};
+    return false;
+}
 
 /**
-  This container is populated with mappings from runtime type identifier to
-  implementation of type-erased operations [Disclosure 1].
+  Sort the values held by the elements of ``iterable``, which are of type
+  ``Variant``, into one group per type, in a single pass.  Consecutive
+  elements of the same type are appended to the group of the previous
+  element without searching for it.
  */
-std::map<std::size_t, SequentialIterableImplementation> converterRegistry;
+void SequentialIterable::partitionByType(const SequentialIterable &iterable, std::vector<TypeGroup> &groups)
+{
+    struct Partition
+    {
+        std::vector<TypeGroup> &groups;
+        std::size_t current;
+
+        void operator()(const void *const *elements, int count)
+        {
+            for (int i = 0; i < count; ++i) {
+                const VariantData &d = static_cast<const Variant*>(elements[i])->data;
+                if (current == groups.size() || groups[current].type != d.metaTypeId) {
+                    current = 0;
+                    while (current < groups.size() && groups[current].type != d.metaTypeId)
+                        ++current;
+                    if (current == groups.size()) {
+                        groups.push_back(TypeGroup());
+                        groups.back().type = d.metaTypeId;
+                    }
+                }
+                groups[current].elements.push_back(d.data);
+            }
+        }
+    } partition = { groups, 0 };
+    iterable.forEachRaw(partition);
+}
+
+template<typename T, typename F>
+void SequentialIterable::visitGroupAs(const TypeGroup &group, F &f)
+{
+    for (std::vector<const void*>::const_iterator it = group.elements.begin(), end = group.elements.end(); it != end; ++it)
+        f(*static_cast<const T*>(*it));
+}
 
 /**
-  @brief User-facing API for using the type-erased container implementation.
+  Call ``f`` with each element of a container of ``Variant``, typed as
+  whichever of ``Ts`` is the type of its value.  Returns the number of
+  elements passed to ``f``; elements of other types are skipped.
+
+  The elements are first partitioned by type, and ``f`` is then called for
+  all elements of the first of ``Ts``, then for all elements of the second,
+  and so on, each group in container order.  The type is therefore
+  dispatched once per group rather than once per element, and the calls for
+  one type are made from a single loop.
+
+  Containers of other element types are visited as by visit(), as a single
+  group.
+ */
+template<typename... Ts, typename F>
+int SequentialIterable::visitGrouped(F &&f) const
+{
+    static_assert(sizeof...(Ts) > 0, "At least one element type must be given");
+
+    if (elementType() != TypeErasure::metaTypeId<Variant>())
+        return visit<Ts...>(f) ? size() : 0;
+
+    std::vector<TypeGroup> groups;
+    partitionByType(*this, groups);
+
+    typedef typename std::remove_reference<F>::type Visitor;
+    typedef void (*GroupFunc)(const TypeGroup &, Visitor &);
+    static const GroupFunc visitors[] = { &SequentialIterable::visitGroupAs<Ts, Visitor>... };
+    static const MetaTypeId types[] = { TypeErasure::metaTypeId<Ts>()... };
+
+    int visited = 0;
+    for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+        for (std::vector<TypeGroup>::const_iterator group = groups.begin(); group != groups.end(); ++group) {
+            if (group->type == types[i]) {
+                visitors[i](*group, f);
+                visited += static_cast<int>(group->elements.size());
+                break;
+            }
+        }
+    }
+    return visited;
+}
 
-  This class implements [Disclosure 7].
+
+/**
+  @brief Depth-first iteration over the leaves of nested containers.
+
+  Elements which are themselves containers, either directly or wrapped in a
+  ``Variant``, are descended into, so that a tree such as a
+  ``std::vector<Variant>`` of containers is traversed in a single pass.
+  Empty containers contribute no elements.  Whether a typed element is a
+  container is determined at compile time with IsNestedContainer, so strings
+  are leaves.  Elements of type ``Variant`` are containers if they were
+  constructed from a nested container, or if they hold only VariantData of
+  a nested container type which is in the converterRegistry.
+
+  The iterator states of the first InlineDepth levels are kept in a
+  fixed-size stack of SequentialIterableImplementation frames, so descending
+  does not allocate for containers whose iterators are stored inline.
+  Deeper levels are kept in a growable overflow stack, so the depth of
+  nesting is not limited.  The table of operations of typed elements is
+  part of the table of their container, and for ``Variant`` elements it is
+  taken from the Variant or from a one-entry cache before falling back to
+  the converterRegistry.
  */
-class SequentialIterable
+class FlatteningIterator
 {
-    SequentialIterableImplementation m_impl;
 public:
-    struct const_iterator;
+    enum { InlineDepth = 16 };
 
-    friend struct const_iterator;
+    explicit FlatteningIterator(const SequentialIterable &root);
+    ~FlatteningIterator();
 
-    explicit SequentialIterable(SequentialIterableImplementation impl);
+    FlatteningIterator(const FlatteningIterator &) = delete;
+    FlatteningIterator &operator=(const FlatteningIterator &) = delete;
 
-    const_iterator begin() const;
-    const_iterator end() const;
+    bool atEnd() const { return m_depth == 0; }
+    int depth() const { return m_depth; }
 
-    int size() const;
+    const Variant operator*() const;
+    FlatteningIterator &operator++();
 
-    bool canReverseIterate() const;
+private:
+    typedef SequentialIterableImplementation::Operations Operations;
+
+    struct Frame
+    {
+        SequentialIterableImplementation current;
+        SequentialIterableImplementation end;
+        const Operations *elementOps;
+    };
+
+    Frame &top() { return m_depth <= InlineDepth ? m_stack[m_depth - 1] : m_overflow[m_depth - 1 - InlineDepth]; }
+    const Frame &top() const { return m_depth <= InlineDepth ? m_stack[m_depth - 1] : m_overflow[m_depth - 1 - InlineDepth]; }
+
+    void push(const void *container, const Operations *ops);
+    void pop();
+    void settle();
+    const Operations *containerOps(const Frame &frame, const VariantData &element, const void **container);
+
+    Frame m_stack[InlineDepth];
+    std::vector<Frame> m_overflow;
+    int m_depth;
+    MetaTypeId m_cachedType;
+    const Operations *m_cachedOps;
 };
 
-int SequentialIterable::size() const
+FlatteningIterator::FlatteningIterator(const SequentialIterable &root)
+  : m_depth(0)
+  , m_cachedType(0)
+  , m_cachedOps(0)
 {
-    return m_impl.size();
+    push(root.m_impl._iterable, root.m_impl._ops);
+    settle();
 }
 
-bool SequentialIterable::canReverseIterate() const
+FlatteningIterator::~FlatteningIterator()
 {
-    return m_impl._iteratorCapabilities & BiDirectionalCapability;
+    while (m_depth > 0)
+        pop();
 }
 
+void FlatteningIterator::push(const void *container, const Operations *ops)
+{
+    if (m_depth >= InlineDepth && m_overflow.size() <= static_cast<std::size_t>(m_depth - InlineDepth))
+        m_overflow.push_back(Frame());
+    ++m_depth;
+    Frame &frame = top();
+    frame.current = SequentialIterableImplementation(container, ops);
+    frame.end = SequentialIterableImplementation(container, ops);
+    frame.current.moveToBegin();
+    frame.end.moveToEnd();
+    frame.elementOps = ops->_elementOps;
+}
 
-/**
-  @brief User-facing API for handling type-erased data which may be a container.
+void FlatteningIterator::pop()
+{
+    Frame &frame = top();
+    frame.current = SequentialIterableImplementation();
+    frame.end = SequentialIterableImplementation();
+    --m_depth;
+}
 
-  This class implements [Disclosure 1].
+/**
+  Returns the table of operations if ``element`` of ``frame`` is a container,
+  and null otherwise.  The address of the container is stored in
+  ``container``.
  */
-struct Variant
+const FlatteningIterator::Operations *
+FlatteningIterator::containerOps(const Frame &frame, const VariantData &element, const void **container)
 {
-  VariantData data;
-
-  /**
-    @brief Contructor accepting a strongly-typed container.
-
-    Populate the converterRegistry ([Disclosure 1]). Forward the strong type
-    to SequentialIterableImplementation to implement [Disclosure 3].
-   */
-  template<typename T>
-  Variant(const T& t)
-    : data(typeid(T).hash_code(), &t)
-  {
-      converterRegistry.insert(std::make_pair(typeid(T).hash_code(), SequentialIterableImplementation(&t)));
-  }
-  Variant(const VariantData data_)
-    : data(data_)
-  {
-  }
-
-  std::size_t type() const
-  {
-      return data.metaTypeId;
-  }
+    if (element.metaTypeId != metaTypeId<Variant>()) {
+        *container = element.data;
+        return frame.elementOps;
+    }
 
-  template<typename T>
-  T as() const
-  {
-      return *reinterpret_cast<const T*>(data.data);
-  }
-};
+    const Variant &v = *static_cast<const Variant*>(element.data);
+    *container = v.data.data;
+    if (v.sequentialOps)
+        return v.sequentialOps->_isNestedContainer ? v.sequentialOps : 0;
+    if (v.data.metaTypeId != m_cachedType) {
+        m_cachedType = v.data.metaTypeId;
+        m_cachedOps = converterRegistry.find(m_cachedType);
+        if (m_cachedOps && !m_cachedOps->_isNestedContainer)
+            m_cachedOps = 0;
+    }
+    return m_cachedOps;
+}
 
-template<>
-SequentialIterable Variant::as<SequentialIterable>() const
+/**
+  Descend from the current position until it is a leaf, leaving exhausted
+  containers on the way.  The stack is empty at the end of the traversal.
+ */
+void FlatteningIterator::settle()
 {
-    assert(converterRegistry.find(data.metaTypeId) != converterRegistry.end());
+    while (m_depth > 0) {
+        Frame &frame = top();
+        if (frame.current.equal(frame.end)) {
+            pop();
+            if (m_depth > 0)
+                top().current.advance(1);
+            continue;
+        }
+        const void *container;
+        const Operations *ops = containerOps(frame, frame.current.getCurrent(), &container);
+        if (!ops)
+            return;
+        push(container, ops);
+    }
+}
 
-    auto impl = converterRegistry[data.metaTypeId];
+/**
+  Returns the current leaf element.  Must not be called at the end.
+ */
+const Variant FlatteningIterator::operator*() const
+{
+    assert(!atEnd());
+    return elementVariant(top().current.getCurrent());
+}
 
-    return SequentialIterable{ impl };
+FlatteningIterator &FlatteningIterator::operator++()
+{
+    assert(!atEnd());
+    top().current.advance(1);
+    settle();
+    return *this;
 }
 
 /**
-  @brief User-facing API for using the type-erased container implementation.
-
-  The implementation of these methods forward to the SequentialIterableImplementation.
+  @brief User-facing API for iterating over a type-erased associative
+  container.
 
-  This class implements [Disclosure 7]
+  The implementation of these methods forward to the
+  AssociativeIterableImplementation.  As for SequentialIterable, each
+  const_iterator owns its iterator state.
  */
-struct SequentialIterable::const_iterator
+struct AssociativeIterable::const_iterator
 {
 private:
-    SequentialIterableImplementation m_impl;
-    std::atomic<int>* ref;
-    friend class SequentialIterable;
-    explicit const_iterator(const SequentialIterable &iter, std::atomic<int>* ref_);
+    AssociativeIterableImplementation m_impl;
+    friend class AssociativeIterable;
+    explicit const_iterator(const AssociativeIterable &iter);
 
-    explicit const_iterator(const SequentialIterableImplementation &impl, std::atomic<int>* ref_);
-
-    void begin();
-    void end();
 public:
-    ~const_iterator();
-
-    const_iterator(const const_iterator &other);
+    // The AssociativeIterableImplementation owns the iterator, so copying
+    // copies it and moving transfers it.
+    const_iterator(const const_iterator &other) = default;
+    const_iterator(const_iterator &&other) = default;
 
-    const_iterator& operator=(const const_iterator &other);
+    const_iterator& operator=(const const_iterator &other) = default;
+    const_iterator& operator=(const_iterator &&other) = default;
 
+    const Variant key() const;
+    const Variant value() const;
     const Variant operator*() const;
     bool operator==(const const_iterator &o) const;
     bool operator!=(const const_iterator &o) const;
@@ -502,154 +3281,208 @@ public:
     const_iterator operator++(int);
     const_iterator &operator--();
     const_iterator operator--(int);
-    const_iterator &operator+=(int j);
-    const_iterator &operator-=(int j);
-    const_iterator operator+(int j) const;
-    const_iterator operator-(int j) const;
 };
 
-SequentialIterable::SequentialIterable(SequentialIterableImplementation impl)
-  : m_impl(impl)
+/**
+  This constructor takes the container and operations from ``iter`` and does
+  not yet hold an iterator; one is assigned by begin(), end() or find().
+ */
+AssociativeIterable::const_iterator::const_iterator(const AssociativeIterable &iter)
+  : m_impl(iter.m_impl._iterable, iter.m_impl._ops)
 {
 }
 
-SequentialIterable::const_iterator::const_iterator(const SequentialIterable &iter, std::atomic<int>* ref_)
-  : m_impl(iter.m_impl), ref(ref_)
+AssociativeIterable::const_iterator AssociativeIterable::begin() const
 {
-    ref->fetch_add(1);
+    const_iterator it(*this);
+    it.m_impl.moveToBegin();
+    return it;
 }
 
-SequentialIterable::const_iterator::const_iterator(const SequentialIterableImplementation &impl, std::atomic<int>* ref_)
-  : m_impl(impl), ref(ref_)
+AssociativeIterable::const_iterator AssociativeIterable::end() const
 {
-    ref->fetch_add(1);
-
+    const_iterator it(*this);
+    it.m_impl.moveToEnd();
+    return it;
 }
 
-void SequentialIterable::const_iterator::begin()
-{
-    m_impl.moveToBegin();
-}
+/**
+  Returns an iterator to the element with the key ``key``, or end() if there
+  is no such element or if ``key`` is not of the keyType() of the container.
 
-void SequentialIterable::const_iterator::end()
+  The lookup uses the ``find`` of the container.
+ */
+AssociativeIterable::const_iterator AssociativeIterable::find(const VariantData &key) const
 {
-    m_impl.moveToEnd();
+    if (key.metaTypeId != keyType())
+        return end();
+    const_iterator it(*this);
+    it.m_impl.find(key.data);
+    return it;
 }
 
-SequentialIterable::const_iterator SequentialIterable::begin() const
+template<typename K>
+AssociativeIterable::const_iterator AssociativeIterable::find(const K &key) const
 {
-    const_iterator it(*this, new std::atomic<int>{});
-    it.begin();
-    return it;
+    return find(VariantData(metaTypeId<K>(), &key));
 }
 
-SequentialIterable::const_iterator SequentialIterable::end() const
+template<typename F>
+void AssociativeIterable::rawBatch(void *context, const void *const *keys, const void *const *values, int count)
 {
-    const_iterator it(*this, new std::atomic<int>{});
-    it.end();
-    return it;
+    (*static_cast<F*>(context))(keys, values, count);
 }
 
-SequentialIterable::const_iterator::~const_iterator() {
-    if (!ref->fetch_sub(1)) {
-        m_impl.destroyIter();
-        delete ref;
-    }
+/**
+  Call ``callback(const void *const *keys, const void *const *values, int
+  count)`` with the addresses of the keys and values of the entries, in
+  order and in batches of up to ``batchSize``, which is clamped to between
+  1 and RawBatchSize.  Returns the number of entries.
+
+  As for SequentialIterable::forEachRaw(), the container is walked by a
+  single typed operation which prefetches the entries a few nodes ahead.
+ */
+template<typename F>
+int AssociativeIterable::forEachRaw(F &&callback, int batchSize) const
+{
+    batchSize = std::max(1, std::min<int>(batchSize, RawBatchSize));
+    typedef typename std::remove_reference<F>::type Callback;
+    const void *keys[RawBatchSize];
+    const void *values[RawBatchSize];
+    return m_impl.forEachRaw(&AssociativeIterable::rawBatch<Callback>,
+                             const_cast<void*>(static_cast<const void*>(&callback)), keys, values, batchSize);
 }
 
-SequentialIterable::const_iterator::const_iterator(const const_iterator &other)
-  : m_impl(other.m_impl), ref(other.ref)
+const Variant AssociativeIterable::const_iterator::key() const
 {
-    ref->fetch_add(1);
+    return elementVariant(m_impl.getCurrentKey());
 }
 
-SequentialIterable::const_iterator&
-SequentialIterable::const_iterator::operator=(const const_iterator &other)
+const Variant AssociativeIterable::const_iterator::value() const
 {
-    if (!m_impl.equal(other.m_impl)) {
-        m_impl = other.m_impl;
-        ref = other.ref;
-    }
-    ref->fetch_add(1);
-    return *this;
+    return elementVariant(m_impl.getCurrentValue());
 }
 
-/**
-  Dereference operator implements [Disclosure 8]
- */
-const Variant SequentialIterable::const_iterator::operator*() const
+const Variant AssociativeIterable::const_iterator::operator*() const
 {
-    const VariantData d = m_impl.getCurrent();
-    if (d.metaTypeId == typeid(Variant).hash_code())
-        return *reinterpret_cast<const Variant*>(d.data);
-    Variant v = { d };
-    return v;
+    return value();
 }
 
-bool SequentialIterable::const_iterator::operator==(const const_iterator &other) const
+bool AssociativeIterable::const_iterator::operator==(const const_iterator &other) const
 {
     return m_impl.equal(other.m_impl);
 }
 
-bool SequentialIterable::const_iterator::operator!=(const const_iterator &other) const
+bool AssociativeIterable::const_iterator::operator!=(const const_iterator &other) const
 {
     return !m_impl.equal(other.m_impl);
 }
 
-SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator++()
+AssociativeIterable::const_iterator &AssociativeIterable::const_iterator::operator++()
 {
     m_impl.advance(1);
     return *this;
 }
 
-SequentialIterable::const_iterator SequentialIterable::const_iterator::operator++(int)
+AssociativeIterable::const_iterator AssociativeIterable::const_iterator::operator++(int)
 {
-    SequentialIterableImplementation impl;
-    impl.copy(m_impl);
+    const_iterator result(*this);
     m_impl.advance(1);
-    return const_iterator(impl, new std::atomic<int>{});
+    return result;
 }
 
-SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator--()
+AssociativeIterable::const_iterator &AssociativeIterable::const_iterator::operator--()
 {
     m_impl.advance(-1);
     return *this;
 }
 
-SequentialIterable::const_iterator SequentialIterable::const_iterator::operator--(int)
+AssociativeIterable::const_iterator AssociativeIterable::const_iterator::operator--(int)
 {
-    SequentialIterableImplementation impl;
-    impl.copy(m_impl);
+    const_iterator result(*this);
     m_impl.advance(-1);
-    return const_iterator(impl, new std::atomic<int>{});
+    return result;
 }
 
-SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator+=(int j)
+/**
+  @brief Writer appending to a contiguous buffer in memory.
+ */
+class BufferWriter : public Writer
 {
-    m_impl.advance(j);
-    return *this;
-}
+public:
+    void write(const void *data, std::size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+    }
 
-SequentialIterable::const_iterator &SequentialIterable::const_iterator::operator-=(int j)
-{
-    m_impl.advance(-j);
-    return *this;
-}
+    const std::vector<unsigned char> &buffer() const { return m_buffer; }
 
-SequentialIterable::const_iterator SequentialIterable::const_iterator::operator+(int j) const
+private:
+    std::vector<unsigned char> m_buffer;
+};
+
+/**
+  @brief Read-only container referring to an array of elements owned
+  elsewhere, such as the elements of a serialized buffer.
+
+  As the const_iterator is a pointer, an ArrayView may itself be wrapped in
+  a Variant and iterated as a contiguous SequentialIterable.
+ */
+template<typename T>
+class ArrayView
 {
-    SequentialIterableImplementation impl;
-    impl.copy(m_impl);
-    impl.advance(j);
-    return const_iterator(impl, new std::atomic<int>{});
-}
+public:
+    typedef T value_type;
+    typedef const T *const_iterator;
 
-SequentialIterable::const_iterator SequentialIterable::const_iterator::operator-(int j) const
+    ArrayView() : m_data(0), m_size(0) {}
+    ArrayView(const T *data, std::size_t size) : m_data(data), m_size(size) {}
+
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+    const T *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    const T *m_data;
+    std::size_t m_size;
+};
+
+/**
+  Set ``view`` to refer to the elements in the serialized ``buffer`` of
+  ``size`` bytes, as written by SequentialIterable::serialize().  Returns
+  false if the buffer is too small, if the elements are not of type ``T``,
+  or if they are not suitably aligned for ``T`` to be accessed in place.
+
+  The elements are not copied, so the buffer must outlive the view.
+ */
+template<typename T>
+bool readSerialized(const void *buffer, std::size_t size, ArrayView<T> *view)
 {
-    SequentialIterableImplementation impl;
-    impl.copy(m_impl);
-    impl.advance(-j);
-    return const_iterator(impl, new std::atomic<int>{});
+    SerializationHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, buffer, sizeof(header));
+    if (header.elementType != wireTypeId<T>() || header.elementSize != sizeof(T))
+        return false;
+
+    // The buffer may come from another process, so the count is checked
+    // against the size of the buffer by division, which can not overflow,
+    // before the byte count is derived from it.
+    if (header.count > (size - sizeof(header)) / sizeof(T))
+        return false;
+    const std::size_t count = static_cast<std::size_t>(header.count);
+    if (header.byteCount != count * sizeof(T))
+        return false;
+
+    const unsigned char *elements = static_cast<const unsigned char*>(buffer) + sizeof(header);
+    if (reinterpret_cast<std::uintptr_t>(elements) % std::alignment_of<T>::value)
+        return false;
+    *view = ArrayView<T>(reinterpret_cast<const T*>(elements), count);
+    return true;
 }
 
 }
+
+#endif